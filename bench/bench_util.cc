@@ -0,0 +1,41 @@
+#include <time.h>
+#include "bench_util.h"
+
+vrtk::WidgetGroup *make_panel(int num, float size, float scale,
+		std::vector<vrtk::Button*> *buttons, vrtk::Button *(*create)())
+{
+	vrtk::WidgetGroup *grp = new vrtk::WidgetGroup;
+
+	int cols = 1;
+	while(cols * cols < num) cols++;
+
+	for(int i=0; i<num; i++) {
+		float x = (float)(i % cols) / (float)cols - 0.5f;
+		float y = (float)(i / cols) / (float)cols - 0.5f;
+
+		vrtk::Button *bn = create ? create() : new vrtk::Button;
+		bn->set_position(Vec3(x * size, y * size, -3.0f));
+		bn->set_scaling(scale / cols);
+		bn->set_color(Vec4(0.5f + x, 0.5f + y, 0.5f, 1.0f));
+		grp->add_widget(bn);
+		if(buttons) {
+			buttons->push_back(bn);
+		}
+	}
+	grp->update();
+	return grp;
+}
+
+long long get_usec()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+long long get_nsec()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
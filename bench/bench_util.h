@@ -0,0 +1,19 @@
+#ifndef BENCH_UTIL_H_
+#define BENCH_UTIL_H_
+
+#include <vector>
+#include "vrtk/vrtk.h"
+
+/* square panel of num buttons at z = -3, size units across and centered on
+ * the -Z axis. Each button is scaled to scale / columns, and colored by its
+ * place in the grid. create makes the buttons, if they're of a subclass, and
+ * if buttons is not null, they're appended to it in order.
+ */
+vrtk::WidgetGroup *make_panel(int num, float size, float scale,
+		std::vector<vrtk::Button*> *buttons = 0, vrtk::Button *(*create)() = 0);
+
+// monotonic time
+long long get_usec();
+long long get_nsec();
+
+#endif	/* BENCH_UTIL_H_ */
@@ -0,0 +1,79 @@
+#include <stdio.h>
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include "egl_ctx.h"
+
+static EGLDisplay dpy;
+static EGLContext ctx;
+static unsigned int fbo, rbuf[2];
+
+bool init_headless_gl(int width, int height)
+{
+	if(!(dpy = eglGetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, 0))) {
+		fprintf(stderr, "failed to get a surfaceless EGL display\n");
+		return false;
+	}
+	if(!eglInitialize(dpy, 0, 0)) {
+		fprintf(stderr, "failed to initialize EGL\n");
+		return false;
+	}
+	eglBindAPI(EGL_OPENGL_API);
+
+	EGLint attr[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	EGLConfig cfg;
+	EGLint num_cfg;
+	if(!eglChooseConfig(dpy, attr, &cfg, 1, &num_cfg) || !num_cfg) {
+		fprintf(stderr, "no suitable EGL config\n");
+		return false;
+	}
+	if(!(ctx = eglCreateContext(dpy, cfg, EGL_NO_CONTEXT, 0))) {
+		fprintf(stderr, "failed to create GL context\n");
+		return false;
+	}
+	if(!eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, ctx)) {
+		fprintf(stderr, "failed to make the GL context current\n");
+		return false;
+	}
+
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glGenRenderbuffers(2, rbuf);
+	glBindRenderbuffer(GL_RENDERBUFFER, rbuf[0]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, rbuf[0]);
+	glBindRenderbuffer(GL_RENDERBUFFER, rbuf[1]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rbuf[1]);
+
+	if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		fprintf(stderr, "incomplete framebuffer\n");
+		return false;
+	}
+	glViewport(0, 0, width, height);
+	return true;
+}
+
+void destroy_headless_gl()
+{
+	if(fbo) {
+		glDeleteFramebuffers(1, &fbo);
+		glDeleteRenderbuffers(2, rbuf);
+		fbo = 0;
+	}
+	if(ctx) {
+		eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext(dpy, ctx);
+		ctx = 0;
+	}
+	if(dpy) {
+		eglTerminate(dpy);
+		dpy = 0;
+	}
+}
@@ -0,0 +1,10 @@
+#ifndef EGL_CTX_H_
+#define EGL_CTX_H_
+
+/* creates a headless GL context (EGL surfaceless, no window system), with an
+ * offscreen framebuffer of the given size bound for drawing
+ */
+bool init_headless_gl(int width, int height);
+void destroy_headless_gl();
+
+#endif	/* EGL_CTX_H_ */
@@ -0,0 +1,164 @@
+/* compares drawing capsule widgets (buttons) as tessellated meshes, against
+ * drawing them as ray traced impostors (WidgetGroup::set_capsule_impostors),
+ * and checks that both cover the same pixels, give or take the silhouette
+ * of the tessellation.
+ *
+ * usage: impostor-bench [num widgets] [num frames]
+ *
+ * Times the draw calls and glFinish. Every frame a few widgets move, so that
+ * the group has to record them again, and the impostors get rebuilt.
+ * Exits with an error if the images differ in more than 1% of the pixels.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include "vrtk/vrtk.h"
+#include "egl_ctx.h"
+#include "bench_util.h"
+
+#define WIDTH	512
+#define HEIGHT	512
+
+static void setup_view();
+static void read_image(std::vector<unsigned char> *img);
+static bool match_pixel(const unsigned char *a, const unsigned char *b, int x, int y);
+static long bench(const char *name);
+
+static vrtk::WidgetGroup *wgroup;
+static std::vector<vrtk::Button*> buttons;
+static std::vector<Vec3> positions;
+static int num_frames = 100;
+
+int main(int argc, char **argv)
+{
+	int num_widgets = 1000;
+
+	if(argc > 1) num_widgets = atoi(argv[1]);
+	if(argc > 2) num_frames = atoi(argv[2]);
+
+	if(!init_headless_gl(WIDTH, HEIGHT)) {
+		return 1;
+	}
+	glEnable(GL_DEPTH_TEST);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	wgroup = make_panel(num_widgets, 2.0f, 0.8f, &buttons);
+
+	// staggered in depth, and turned every which way
+	for(int i=0; i<num_widgets; i++) {
+		Vec3 pos = buttons[i]->get_position() - Vec3(0, 0, (i & 3) * 0.1f);
+		buttons[i]->set_position(pos);
+		buttons[i]->set_rotation(Quat(Vec3(0.3f, 1, 0.2f), i * 0.7f));
+		positions.push_back(pos);
+	}
+
+	printf("%s: %d widgets, %d frames\n", (const char*)glGetString(GL_RENDERER),
+			num_widgets, num_frames);
+
+	std::vector<unsigned char> mesh_img, imp_img;
+	setup_view();
+	wgroup->draw();
+	read_image(&mesh_img);
+
+	wgroup->set_capsule_impostors(true);
+	wgroup->draw();
+	read_image(&imp_img);
+
+	int ndiff = 0, ncover = 0;
+	int npix = WIDTH * HEIGHT;
+	for(int i=0; i<HEIGHT; i++) {
+		for(int j=0; j<WIDTH; j++) {
+			if(!match_pixel(&mesh_img[0], &imp_img[0], j, i)) {
+				ndiff++;
+			}
+			const unsigned char *p = &imp_img[(i * WIDTH + j) * 4];
+			if(p[0] | p[1] | p[2]) {
+				ncover++;
+			}
+		}
+	}
+	float diff = 100.0f * ndiff / npix;
+	printf("impostors cover %.2f%% of the image\n", 100.0f * ncover / npix);
+	printf("image difference: %.2f%% of pixels\n", diff);
+
+	wgroup->set_capsule_impostors(false);
+	long t_mesh = bench("meshes");
+	wgroup->set_capsule_impostors(true);
+	long t_imp = bench("impostors");
+
+	printf("impostors / meshes: %.2f\n", (double)t_imp / (double)t_mesh);
+
+	delete wgroup;
+	destroy_headless_gl();
+	return diff > 1.0f || !ncover ? 1 : 0;
+}
+
+static void setup_view()
+{
+	glViewport(0, 0, WIDTH, HEIGHT);
+
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	glFrustum(-0.05, 0.05, -0.05, 0.05, 0.1, 100.0);
+
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+}
+
+static void read_image(std::vector<unsigned char> *img)
+{
+	img->resize(WIDTH * HEIGHT * 4);
+	glReadPixels(0, 0, WIDTH, HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, &(*img)[0]);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+/* the tessellated silhouette lies inside the exact one, so edges may move by
+ * a pixel: a pixel matches if any pixel next to it in the other image is
+ * close enough
+ */
+static bool match_pixel(const unsigned char *a, const unsigned char *b, int x, int y)
+{
+	const unsigned char *pa = a + (y * WIDTH + x) * 4;
+
+	for(int i=-1; i<=1; i++) {
+		for(int j=-1; j<=1; j++) {
+			int sx = x + j;
+			int sy = y + i;
+			if(sx < 0 || sx >= WIDTH || sy < 0 || sy >= HEIGHT) continue;
+
+			const unsigned char *pb = b + (sy * WIDTH + sx) * 4;
+			if(abs(pa[0] - pb[0]) <= 32 && abs(pa[1] - pb[1]) <= 32 && abs(pa[2] - pb[2]) <= 32) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+static long bench(const char *name)
+{
+	int num = buttons.size();
+	long total = 0;
+	for(int i=0; i<num_frames; i++) {
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		for(int j=0; j<4; j++) {
+			int idx = (i * 4 + j) % num;
+			float offs = sin(i * 0.1f) * 0.01f;
+			buttons[idx]->set_position(positions[idx] + Vec3(0, offs, 0));
+		}
+
+		long long start = get_usec();
+		setup_view();
+		wgroup->draw();
+		glFinish();
+		total += get_usec() - start;
+	}
+
+	printf("%-12s %8.1f usec/frame\n", name, (double)total / num_frames);
+	return total;
+}
@@ -0,0 +1,161 @@
+/* measures the latency of pointer event dispatch (input_ray_pointer and
+ * input_button) against a large panel of buttons, and checks that hover,
+ * grab and activation events arrive as expected.
+ *
+ * usage: input-bench [num widgets] [num events]
+ *
+ * The pointer ray sweeps across the panel, and every 16th update presses or
+ * releases a button. Prints the mean and percentiles of the time each call
+ * takes, including the events it sends. Then does the same with three
+ * pointers (two controllers and a gaze ray), updated one by one and batched
+ * (input_process_pointers). Needs no GL context.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include "vrtk/vrtk.h"
+#include "bench_util.h"
+
+class CountButton : public vrtk::Button {
+public:
+	static int num_hover, num_grab, num_release, num_activate;
+
+	void on_hover(bool hover)
+	{
+		vrtk::Button::on_hover(hover);
+		if(hover) num_hover++;
+	}
+	void on_grab(const Vec3 &pos, const Quat &rot)
+	{
+		vrtk::Button::on_grab(pos, rot);
+		num_grab++;
+	}
+	void on_release(const Vec3 &pos, const Quat &rot)
+	{
+		vrtk::Button::on_release(pos, rot);
+		num_release++;
+	}
+	void on_activate(const Vec3 &pos, const Quat &rot)
+	{
+		vrtk::Button::on_activate(pos, rot);
+		num_activate++;
+	}
+};
+
+int CountButton::num_hover, CountButton::num_grab;
+int CountButton::num_release, CountButton::num_activate;
+
+static vrtk::Button *new_count_button()
+{
+	return new CountButton;
+}
+
+static void print_stats(const char *name, std::vector<long> &times);
+static void bench_pointers(int num_events, bool batched);
+
+int main(int argc, char **argv)
+{
+	int num_widgets = 10000;
+	int num_events = 100000;
+
+	if(argc > 1) num_widgets = atoi(argv[1]);
+	if(argc > 2) num_events = atoi(argv[2]);
+
+	vrtk::WidgetGroup *wgroup = make_panel(num_widgets, 2.0f, 0.4f, 0, new_count_button);
+	vrtk::input_add_group(wgroup);
+
+	printf("%d widgets, %d events\n", num_widgets, num_events);
+
+	std::vector<long> move_times, button_times;
+	move_times.reserve(num_events);
+	button_times.reserve(num_events / 16 + 1);
+
+	bool pressed = false;
+	for(int i=0; i<num_events; i++) {
+		// slow sweep, so that presses and releases land on the same button
+		float t = i * 0.0005f;
+		Vec3 dir = Vec3(sin(t) * 0.3f, sin(t * 0.77f) * 0.3f, -1.0f);
+
+		long long start = get_nsec();
+		vrtk::input_ray_pointer(Vec3(0, 0, 0), dir);
+		move_times.push_back(get_nsec() - start);
+
+		if(i % 16 == 15) {
+			pressed = !pressed;
+			start = get_nsec();
+			vrtk::input_button(0, pressed);
+			button_times.push_back(get_nsec() - start);
+		}
+	}
+
+	print_stats("pointer", move_times);
+	print_stats("button", button_times);
+	printf("events: %d hover, %d grab, %d release, %d activate\n", CountButton::num_hover,
+			CountButton::num_grab, CountButton::num_release, CountButton::num_activate);
+
+	bench_pointers(num_events / 4, false);
+	bench_pointers(num_events / 4, true);
+
+	delete wgroup;
+
+	bool ok = CountButton::num_hover > 0 && CountButton::num_grab > 0 &&
+		CountButton::num_release == CountButton::num_grab - (pressed ? 1 : 0) &&
+		CountButton::num_activate > 0;
+	if(!ok) {
+		fprintf(stderr, "unexpected event counts\n");
+	}
+	return ok ? 0 : 1;
+}
+
+// the times are per frame, for updating all three pointers
+static void bench_pointers(int num_events, bool batched)
+{
+	int ptr[3];
+	for(int i=0; i<3; i++) {
+		ptr[i] = vrtk::input_add_pointer();
+	}
+
+	std::vector<long> times;
+	times.reserve(num_events);
+
+	for(int i=0; i<num_events; i++) {
+		long long start = get_nsec();
+		for(int j=0; j<3; j++) {
+			float t = i * 0.0005f + j * 2.0f;
+			Vec3 dir = Vec3(sin(t) * 0.3f, sin(t * 0.77f) * 0.3f, -1.0f);
+			if(batched) {
+				vrtk::input_set_ray_pointer(ptr[j], Vec3(0, 0, 0), dir);
+			} else {
+				vrtk::input_ray_pointer(ptr[j], Vec3(0, 0, 0), dir);
+			}
+		}
+		if(batched) {
+			vrtk::input_process_pointers();
+		}
+		times.push_back(get_nsec() - start);
+	}
+
+	print_stats(batched ? "3 batch" : "3 ptrs", times);
+
+	for(int i=0; i<3; i++) {
+		vrtk::input_remove_pointer(ptr[i]);
+	}
+}
+
+static void print_stats(const char *name, std::vector<long> &times)
+{
+	if(times.empty()) return;
+
+	int num = times.size();
+	double sum = 0.0;
+	for(int i=0; i<num; i++) {
+		sum += times[i];
+	}
+	std::sort(times.begin(), times.end());
+
+	printf("%-8s mean %8.2f usec, p50 %8.2f, p99 %8.2f, max %8.2f\n", name,
+			sum / num / 1000.0, times[num / 2] / 1000.0, times[num * 99 / 100] / 1000.0,
+			times[num - 1] / 1000.0);
+}
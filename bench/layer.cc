@@ -0,0 +1,154 @@
+/* compares drawing a static panel of widgets directly, against drawing it
+ * through a cached layer (WidgetGroup::set_layer_caching), and checks that
+ * both produce the same image, give or take filtering at the edges.
+ *
+ * usage: layer-bench [num widgets] [num frames]
+ *
+ * Times the draw calls and glFinish, since the layer saves GPU work as well.
+ * The viewer sways slightly, within the parallax threshold, and a widget
+ * changes color every 10 frames, forcing the layer to be drawn again.
+ * Exits with an error if the images differ in more than 1% of the pixels.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include "vrtk/vrtk.h"
+#include "egl_ctx.h"
+#include "bench_util.h"
+
+#define WIDTH	512
+#define HEIGHT	512
+
+static void setup_view(const Vec3 &viewer);
+static void read_image(std::vector<unsigned char> *img);
+static bool match_pixel(const unsigned char *a, const unsigned char *b, int x, int y);
+static long bench(const char *name);
+
+static vrtk::WidgetGroup *wgroup;
+static std::vector<vrtk::Button*> buttons;
+static int num_frames = 100;
+
+int main(int argc, char **argv)
+{
+	int num_widgets = 400;
+
+	if(argc > 1) num_widgets = atoi(argv[1]);
+	if(argc > 2) num_frames = atoi(argv[2]);
+
+	if(!init_headless_gl(WIDTH, HEIGHT)) {
+		return 1;
+	}
+	glEnable(GL_DEPTH_TEST);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	wgroup = make_panel(num_widgets, 2.0f, 1.0f, &buttons);
+
+	printf("%s: %d widgets, %d frames\n", (const char*)glGetString(GL_RENDERER),
+			num_widgets, num_frames);
+
+	// same image both ways, from the same viewpoint
+	std::vector<unsigned char> direct_img, layer_img;
+	setup_view(Vec3(0, 0, 0));
+	wgroup->draw();
+	read_image(&direct_img);
+
+	wgroup->set_layer_caching(true, WIDTH, HEIGHT);
+	wgroup->set_viewer(Vec3(0, 0, 0));
+	wgroup->draw();
+	read_image(&layer_img);
+
+	int ndiff = 0;
+	int npix = WIDTH * HEIGHT;
+	for(int i=0; i<HEIGHT; i++) {
+		for(int j=0; j<WIDTH; j++) {
+			if(!match_pixel(&direct_img[0], &layer_img[0], j, i)) {
+				ndiff++;
+			}
+		}
+	}
+	float diff = 100.0f * ndiff / npix;
+	printf("image difference: %.2f%% of pixels\n", diff);
+
+	wgroup->set_layer_caching(false);
+	long t_direct = bench("direct");
+	wgroup->set_layer_caching(true, WIDTH, HEIGHT);
+	long t_layer = bench("layer");
+
+	printf("layer / direct: %.2f\n", (double)t_layer / (double)t_direct);
+
+	delete wgroup;
+	destroy_headless_gl();
+	return diff > 1.0f ? 1 : 0;
+}
+
+static void setup_view(const Vec3 &viewer)
+{
+	glViewport(0, 0, WIDTH, HEIGHT);
+
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	glFrustum(-0.05, 0.05, -0.05, 0.05, 0.1, 100.0);
+
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+	glTranslatef(-viewer.x, -viewer.y, -viewer.z);
+}
+
+static void read_image(std::vector<unsigned char> *img)
+{
+	img->resize(WIDTH * HEIGHT * 4);
+	glReadPixels(0, 0, WIDTH, HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, &(*img)[0]);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+/* the layer is resampled, so edges may move by a pixel: a pixel matches if
+ * any pixel next to it in the other image is close enough
+ */
+static bool match_pixel(const unsigned char *a, const unsigned char *b, int x, int y)
+{
+	const unsigned char *pa = a + (y * WIDTH + x) * 4;
+
+	for(int i=-1; i<=1; i++) {
+		for(int j=-1; j<=1; j++) {
+			int sx = x + j;
+			int sy = y + i;
+			if(sx < 0 || sx >= WIDTH || sy < 0 || sy >= HEIGHT) continue;
+
+			const unsigned char *pb = b + (sy * WIDTH + sx) * 4;
+			if(abs(pa[0] - pb[0]) <= 32 && abs(pa[1] - pb[1]) <= 32 && abs(pa[2] - pb[2]) <= 32) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+static long bench(const char *name)
+{
+	long total = 0;
+	for(int i=0; i<num_frames; i++) {
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		// a few millimeters of head sway
+		Vec3 viewer = Vec3(sin(i * 0.1f), cos(i * 0.13f), 0.0f) * 0.005f;
+
+		if(i % 10 == 0) {
+			float c = (float)(i % 20) / 20.0f;
+			buttons[i % buttons.size()]->set_color(Vec4(1, c, c, 1));
+		}
+
+		long long start = get_usec();
+		setup_view(viewer);
+		wgroup->set_viewer(viewer);
+		wgroup->draw();
+		glFinish();
+		total += get_usec() - start;
+	}
+
+	printf("%-12s %8.1f usec/frame\n", name, (double)total / num_frames);
+	return total;
+}
@@ -0,0 +1,189 @@
+/* stress test of the input event queue (input_post_* and input_drain_queue),
+ * with a latency histogram.
+ *
+ * usage: queue-bench [producer rate in Hz, 0: flat out] [seconds]
+ *
+ * A producer thread posts a pointer ray aimed at a button, wobbling enough to
+ * drag it, and presses and releases a button every 50 samples. The main
+ * thread drains the queue at 90Hz. Checks that every button edge arrives,
+ * in order, and prints how long events waited in the queue before their
+ * handlers ran.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <thread>
+#include <atomic>
+#include "vrtk/vrtk.h"
+#include "bench_util.h"
+
+#define HIST_SIZE	24
+
+static void producer(int rate, long long end_time);
+static void record_latency();
+
+class EdgeButton : public vrtk::Button {
+public:
+	void on_grab(const Vec3 &pos, const Quat &rot);
+	void on_release(const Vec3 &pos, const Quat &rot);
+	void on_drag(const Vec3 &pos, const Quat &rot);
+};
+
+static std::atomic<int> num_posted, num_presses, num_releases, num_full;
+static int num_grabs, num_released, num_drags;
+static bool out_of_order;
+static bool held;
+
+// latencies, in power of two usec buckets
+static long hist[HIST_SIZE];
+
+int main(int argc, char **argv)
+{
+	int rate = 1000;
+	float seconds = 2.0f;
+
+	if(argc > 1) rate = atoi(argv[1]);
+	if(argc > 2) seconds = atof(argv[2]);
+
+	vrtk::WidgetGroup *wgroup = new vrtk::WidgetGroup;
+	EdgeButton *bn = new EdgeButton;
+	bn->set_position(Vec3(0, 0, -3));
+	wgroup->add_widget(bn);
+	wgroup->update();
+	vrtk::input_add_group(wgroup);
+	vrtk::set_drag_threshold(0.001f);
+
+	printf("producer at %s%d Hz, consumer at 90 Hz, for %.1f seconds\n",
+			rate ? "" : "flat out, ", rate, seconds);
+
+	long long end_time = get_usec() + (long long)(seconds * 1000000.0f);
+	std::thread prod(producer, rate, end_time);
+
+	int num_frames = 0, num_drained = 0;
+	for(;;) {
+		bool done = get_usec() >= end_time;
+
+		num_drained += vrtk::input_drain_queue();
+		num_frames++;
+
+		if(done && num_drained == num_posted) break;
+
+		struct timespec ts = {0, 11111111};
+		nanosleep(&ts, 0);
+	}
+	prod.join();
+	num_drained += vrtk::input_drain_queue();
+
+	printf("%d events in %d frames, %d full queue retries\n", num_drained, num_frames,
+			(int)num_full);
+	printf("%d presses: %d grabs, %d releases: %d released, %d drags\n", (int)num_presses,
+			num_grabs, (int)num_releases, num_released, num_drags);
+
+	printf("latency from post to handler:\n");
+	long total = 0;
+	for(int i=0; i<HIST_SIZE; i++) {
+		total += hist[i];
+	}
+	for(int i=0; i<HIST_SIZE; i++) {
+		if(!hist[i]) continue;
+		printf(" < %8ld usec: %6ld  ", 1L << (i + 1), hist[i]);
+		int bar = (int)(hist[i] * 50 / total);
+		for(int j=0; j<bar; j++) putchar('#');
+		putchar('\n');
+	}
+
+	delete wgroup;
+
+	bool ok = num_grabs == num_presses && num_released == num_releases && !out_of_order;
+	if(!ok) {
+		fprintf(stderr, "button edges lost or out of order\n");
+	}
+	return ok ? 0 : 1;
+}
+
+static void producer(int rate, long long end_time)
+{
+	long interval = rate > 0 ? 1000000 / rate : 0;
+	long long next = get_usec();
+	int i = 0;
+	bool pressed = false;
+
+	while(get_usec() < end_time) {
+		float t = i * 0.01f;
+		Vec3 dir = Vec3(sin(t) * 0.05f, cos(t * 1.3f) * 0.02f, -1.0f);
+
+		while(!vrtk::input_post_ray_pointer(0, Vec3(0, 0, 0), dir, get_usec())) {
+			num_full++;
+			std::this_thread::yield();
+		}
+		num_posted++;
+
+		if(++i % 50 == 0) {
+			pressed = !pressed;
+			while(!vrtk::input_post_button(0, 0, pressed, get_usec())) {
+				num_full++;
+				std::this_thread::yield();
+			}
+			num_posted++;
+			if(pressed) {
+				num_presses++;
+			} else {
+				num_releases++;
+			}
+		}
+
+		if(interval) {
+			next += interval;
+			long long now = get_usec();
+			if(next > now) {
+				struct timespec ts = {0, (long)((next - now) * 1000)};
+				nanosleep(&ts, 0);
+			}
+		}
+	}
+
+	// don't leave the button held
+	if(pressed) {
+		while(!vrtk::input_post_button(0, 0, false, get_usec())) {
+			std::this_thread::yield();
+		}
+		num_posted++;
+		num_releases++;
+	}
+}
+
+static void record_latency()
+{
+	long lat = (long)(get_usec() - vrtk::input_get_event_time());
+	int bucket = 0;
+	while(bucket < HIST_SIZE - 1 && lat >= (2L << bucket)) {
+		bucket++;
+	}
+	hist[bucket]++;
+}
+
+void EdgeButton::on_grab(const Vec3 &pos, const Quat &rot)
+{
+	vrtk::Button::on_grab(pos, rot);
+	if(held) out_of_order = true;
+	held = true;
+	num_grabs++;
+	record_latency();
+}
+
+void EdgeButton::on_release(const Vec3 &pos, const Quat &rot)
+{
+	vrtk::Button::on_release(pos, rot);
+	if(!held) out_of_order = true;
+	held = false;
+	num_released++;
+	record_latency();
+}
+
+void EdgeButton::on_drag(const Vec3 &pos, const Quat &rot)
+{
+	vrtk::Button::on_drag(pos, rot);
+	num_drags++;
+	record_latency();
+}
@@ -0,0 +1,137 @@
+/* plays back an input log (see input_record_start) against a panel of
+ * buttons, as fast as possible, and reports how long dispatching each kind
+ * of input call took.
+ *
+ * usage: input-replay [options] <log file>
+ *  -n <num>   number of buttons in the test scene (default 10000)
+ *  -r         record a synthetic session into the log file first: two
+ *             pointers sweeping over the panel, clicking and dragging
+ *
+ * Pointer updates do their picking in "process" calls, so those are the
+ * ones to watch. Exits with an error if the log can't be read.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include "vrtk/vrtk.h"
+#include "input_log.h"
+#include "bench_util.h"
+
+static const char *type_names[] = {
+	"keyboard", "ray set", "3d set", "button", "process", "add ptr", "remove ptr", "display"
+};
+
+static void record_session(const char *fname);
+
+int main(int argc, char **argv)
+{
+	int num_widgets = 10000;
+	bool gen = false;
+	const char *fname = 0;
+
+	for(int i=1; i<argc; i++) {
+		if(strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			num_widgets = atoi(argv[++i]);
+		} else if(strcmp(argv[i], "-r") == 0) {
+			gen = true;
+		} else if(argv[i][0] != '-') {
+			fname = argv[i];
+		} else {
+			fprintf(stderr, "usage: %s [-n <num widgets>] [-r] <log file>\n", argv[0]);
+			return 1;
+		}
+	}
+	if(!fname) {
+		fprintf(stderr, "no input log given\n");
+		return 1;
+	}
+
+	vrtk::WidgetGroup *wgroup = make_panel(num_widgets, 2.0f, 0.4f);
+	vrtk::input_add_group(wgroup);
+
+	if(gen) {
+		record_session(fname);
+	}
+
+	// read it all first, to time only the dispatch
+	std::vector<vrtk::InputRecord> log;
+	vrtk::InputLogReader reader;
+	if(!reader.open(fname)) {
+		return 1;
+	}
+	vrtk::InputRecord rec;
+	while(reader.read(&rec)) {
+		log.push_back(rec);
+	}
+	reader.close();
+
+	printf("%s: %d records, %.2f sec, %d widgets\n", fname, (int)log.size(),
+			log.empty() ? 0.0 : log.back().time / 1000000.0, num_widgets);
+
+	std::vector<long> times[vrtk::NUM_ILOG_TYPES];
+	std::vector<int> ptrmap;
+
+	long total = 0;
+	int num = log.size();
+	for(int i=0; i<num; i++) {
+		long long start = get_nsec();
+		vrtk::replay_record(log[i], &ptrmap);
+		long dt = (long)(get_nsec() - start);
+
+		times[log[i].type].push_back(dt);
+		total += dt;
+	}
+
+	printf("%-10s %8s %10s %10s %10s %10s (usec)\n", "call", "count", "p50", "p90", "p99", "max");
+	for(int i=0; i<vrtk::NUM_ILOG_TYPES; i++) {
+		std::vector<long> &t = times[i];
+		int n = t.size();
+		if(!n) continue;
+
+		std::sort(t.begin(), t.end());
+		printf("%-10s %8d %10.2f %10.2f %10.2f %10.2f\n", type_names[i], n, t[n / 2] / 1000.0,
+				t[n * 9 / 10] / 1000.0, t[n * 99 / 100] / 1000.0, t[n - 1] / 1000.0);
+	}
+	printf("total %.2f msec\n", total / 1000000.0);
+
+	delete wgroup;
+	return 0;
+}
+
+static void record_session(const char *fname)
+{
+	if(!vrtk::input_record_start(fname)) {
+		exit(1);
+	}
+
+	int ptr[2];
+	for(int i=0; i<2; i++) {
+		ptr[i] = vrtk::input_add_pointer();
+	}
+
+	long long usec = 0;
+	for(int i=0; i<20000; i++) {
+		usec += 11111;
+
+		for(int j=0; j<2; j++) {
+			float t = i * 0.002f + j * 2.0f;
+			Vec3 dir = Vec3(sin(t) * 0.3f, sin(t * 0.77f) * 0.3f, -1.0f);
+			vrtk::input_set_ray_pointer(ptr[j], Vec3(0, 0, 0), dir, usec);
+		}
+		vrtk::input_process_pointers();
+
+		if(i % 20 == 10) {
+			vrtk::input_button(ptr[i & 1], 0, true);
+		} else if(i % 20 == 15) {
+			vrtk::input_button(ptr[i & 1], 0, false);
+		}
+	}
+
+	for(int i=0; i<2; i++) {
+		vrtk::input_remove_pointer(ptr[i]);
+	}
+	vrtk::input_record_stop();
+}
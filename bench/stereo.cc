@@ -0,0 +1,177 @@
+/* compares the CPU cost of drawing a widget group for both eyes with two
+ * calls to WidgetGroup::draw, against the single pass stereo entry points.
+ *
+ * usage: stereo-bench [num widgets] [num frames]
+ *
+ * Times only the draw calls, not glFinish. Software renderers (llvmpipe)
+ * still do vertex processing in the calling thread, which is the same in
+ * all cases; the difference between them is what vrtk saves.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include "vrtk/vrtk.h"
+#include "egl_ctx.h"
+#include "bench_util.h"
+
+#define EYE_WIDTH	320
+#define EYE_HEIGHT	320
+#define IPD			0.064f
+
+static void setup_eye(int eye, void *cls);
+static unsigned int create_stereo_program();
+static long bench(const char *name, void (*draw)());
+static void draw_two_pass();
+static void draw_one_pass();
+static void draw_instanced();
+
+static vrtk::WidgetGroup *wgroup;
+static int num_frames = 100;
+
+int main(int argc, char **argv)
+{
+	int num_widgets = 200;
+
+	if(argc > 1) num_widgets = atoi(argv[1]);
+	if(argc > 2) num_frames = atoi(argv[2]);
+
+	if(!init_headless_gl(EYE_WIDTH * 2, EYE_HEIGHT)) {
+		return 1;
+	}
+	glEnable(GL_DEPTH_TEST);
+	// only the cost of submission matters here, not filling pixels
+	glEnable(GL_RASTERIZER_DISCARD);
+
+	wgroup = make_panel(num_widgets, 4.0f, 2.0f);
+
+	printf("%s: %d widgets, %d frames\n", (const char*)glGetString(GL_RENDERER),
+			num_widgets, num_frames);
+
+	long t2 = bench("two passes", draw_two_pass);
+	long t1 = bench("one pass", draw_one_pass);
+
+	unsigned int prog = create_stereo_program();
+	if(prog) {
+		glUseProgram(prog);
+		vrtk::set_active_program(prog);
+		bench("instanced", draw_instanced);
+		glUseProgram(0);
+		vrtk::set_active_program(0);
+	}
+
+	printf("one pass / two passes: %.2f (%.1f usec/frame saved)\n", (double)t1 / (double)t2,
+			(double)(t2 - t1) / num_frames);
+
+	delete wgroup;
+	destroy_headless_gl();
+	return 0;
+}
+
+static void setup_eye(int eye, void *cls)
+{
+	glViewport(eye * EYE_WIDTH, 0, EYE_WIDTH, EYE_HEIGHT);
+
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	glFrustum(-0.1, 0.1, -0.1, 0.1, 0.1, 100.0);
+
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+	glTranslatef(eye ? -IPD / 2.0f : IPD / 2.0f, 0, 0);
+}
+
+/* draws to both halves of the target, picking the eye by instance id */
+static unsigned int create_stereo_program()
+{
+	static const char *vsrc =
+		"#version 140\n"
+		"#extension GL_ARB_compatibility : enable\n"
+		"in vec4 attr_vertex;\n"
+		"uniform float ipd;\n"
+		"void main()\n"
+		"{\n"
+		"	float eye = float(gl_InstanceID);\n"
+		"	vec4 p = gl_ModelViewMatrix * attr_vertex;\n"
+		"	p.x += ipd * (0.5 - eye);\n"
+		"	gl_Position = gl_ProjectionMatrix * p;\n"
+		"	gl_Position.x = gl_Position.x * 0.5 + (eye - 0.5) * gl_Position.w;\n"
+		"	gl_FrontColor = gl_Color;\n"
+		"}\n";
+	static const char *psrc =
+		"void main()\n"
+		"{\n"
+		"	gl_FragColor = gl_Color;\n"
+		"}\n";
+
+	unsigned int vs = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(vs, 1, &vsrc, 0);
+	glCompileShader(vs);
+	unsigned int ps = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(ps, 1, &psrc, 0);
+	glCompileShader(ps);
+
+	unsigned int prog = glCreateProgram();
+	glAttachShader(prog, vs);
+	glAttachShader(prog, ps);
+	// vrtk feeds vertex positions to attribute 0 by default
+	glBindAttribLocation(prog, 0, "attr_vertex");
+	glLinkProgram(prog);
+
+	int status;
+	glGetProgramiv(prog, GL_LINK_STATUS, &status);
+	if(!status) {
+		fprintf(stderr, "failed to create the instanced stereo program, skipping\n");
+		glDeleteProgram(prog);
+		return 0;
+	}
+
+	glUseProgram(prog);
+	glUniform1f(glGetUniformLocation(prog, "ipd"), IPD);
+	glUseProgram(0);
+	return prog;
+}
+
+static long bench(const char *name, void (*draw)())
+{
+	draw();		// warm up: buffer uploads and such
+	glFinish();
+
+	long total = 0;
+	for(int i=0; i<num_frames; i++) {
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		long long start = get_usec();
+		draw();
+		total += get_usec() - start;
+
+		glFinish();
+	}
+
+	printf("%-12s %8.1f usec/frame\n", name, (double)total / num_frames);
+	return total;
+}
+
+static void draw_two_pass()
+{
+	for(int i=0; i<2; i++) {
+		setup_eye(i, 0);
+		wgroup->draw();
+	}
+}
+
+static void draw_one_pass()
+{
+	wgroup->draw_stereo(setup_eye);
+}
+
+static void draw_instanced()
+{
+	// the program offsets each eye, and squeezes it into its half
+	setup_eye(0, 0);
+	glLoadIdentity();
+	glViewport(0, 0, EYE_WIDTH * 2, EYE_HEIGHT);
+
+	wgroup->draw_stereo_instanced();
+}
@@ -0,0 +1,602 @@
+/* microbenchmarks of the CPU side of vrtk: the geometric intersection tests,
+ * capsule shapes, mesh picking, generation and manipulation, and picking a
+ * widget group as it grows. Needs no GL context.
+ *
+ * usage: vrtk-bench [options] [name filter]
+ *  -o <file>   also write the results to a file, to use as a baseline later
+ *  -b <file>   compare against a baseline, and exit with 1 on regressions
+ *  -t <pct>    slowdown over the baseline counted as a regression (default 10)
+ *  -r <runs>   timed runs of each benchmark (default 7)
+ *  -m <msec>   minimum duration of each run (default 20)
+ *
+ * Each benchmark is calibrated to run for at least the minimum duration, and
+ * then timed several times. Output is one line per benchmark, tab-separated:
+ * name, median and minimum nanoseconds per operation, and the number of
+ * operations per run. Comparing adds the baseline median, and the change in
+ * percent. Inputs come from a fixed seed, so runs are reproducible.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include "vrtk/vrtk.h"
+#include "geom.h"
+#include "mesh.h"
+#include "meshgen.h"
+#include "shape_caps.h"
+#include "bench_util.h"
+
+#define NUM_INPUTS	1024
+
+struct Bench {
+	std::string name;
+	void (*func)(int count, void *cls);	// runs count operations
+	void *cls;
+};
+
+struct Result {
+	std::string name;
+	double median, min;	// nanoseconds per operation
+	int count;
+};
+
+static void add_benches();
+static bool parse_args(int argc, char **argv);
+static bool load_baseline(const char *fname);
+static Result run_bench(const Bench &b);
+
+static std::vector<Bench> benches;
+static std::map<std::string, double> baseline;
+
+static const char *filter, *out_fname, *base_fname;
+static float threshold = 10.0f;
+static int num_runs = 7;
+static int min_msec = 20;
+
+// results go here, so that the compiler can't drop the work
+volatile float sink;
+
+int main(int argc, char **argv)
+{
+	if(!parse_args(argc, argv)) {
+		return 1;
+	}
+	if(base_fname && !load_baseline(base_fname)) {
+		return 1;
+	}
+
+	FILE *out = 0;
+	if(out_fname && !(out = fopen(out_fname, "w"))) {
+		fprintf(stderr, "failed to open %s for writing\n", out_fname);
+		return 1;
+	}
+
+	add_benches();
+
+	printf("# name\tmedian_ns\tmin_ns\tops%s\n", base_fname ? "\tbase_ns\tchange_pct" : "");
+	if(out) {
+		fprintf(out, "# name\tmedian_ns\tmin_ns\tops\n");
+	}
+
+	int num_slower = 0;
+	int num = benches.size();
+	for(int i=0; i<num; i++) {
+		if(filter && !strstr(benches[i].name.c_str(), filter)) {
+			continue;
+		}
+
+		Result res = run_bench(benches[i]);
+		printf("%s\t%.2f\t%.2f\t%d", res.name.c_str(), res.median, res.min, res.count);
+
+		std::map<std::string, double>::iterator it = baseline.find(res.name);
+		if(it != baseline.end()) {
+			double change = (res.median / it->second - 1.0) * 100.0;
+			printf("\t%.2f\t%+.1f", it->second, change);
+			if(change > threshold) {
+				printf("\tSLOWER");
+				num_slower++;
+			}
+		}
+		putchar('\n');
+		fflush(stdout);
+
+		if(out) {
+			fprintf(out, "%s\t%.2f\t%.2f\t%d\n", res.name.c_str(), res.median, res.min, res.count);
+		}
+	}
+
+	if(out) {
+		fclose(out);
+	}
+	if(num_slower) {
+		fprintf(stderr, "%d benchmarks slower than the baseline by more than %g%%\n",
+				num_slower, threshold);
+		return 1;
+	}
+	return 0;
+}
+
+static Result run_bench(const Bench &b)
+{
+	long min_nsec = min_msec * 1000000L;
+
+	// first calls build lazily computed data, such as picking bounds
+	b.func(1, b.cls);
+
+	// double the count until a run takes long enough
+	int count = 1;
+	for(;;) {
+		long long start = get_nsec();
+		b.func(count, b.cls);
+		if(get_nsec() - start >= min_nsec || count >= (1 << 28)) {
+			break;
+		}
+		count *= 2;
+	}
+
+	std::vector<double> times;
+	for(int i=0; i<num_runs; i++) {
+		long long start = get_nsec();
+		b.func(count, b.cls);
+		times.push_back((double)(get_nsec() - start) / count);
+	}
+	std::sort(times.begin(), times.end());
+
+	Result res;
+	res.name = b.name;
+	res.median = times[times.size() / 2];
+	res.min = times[0];
+	res.count = count;
+	return res;
+}
+
+static void add_bench(const char *name, void (*func)(int, void*), void *cls = 0)
+{
+	Bench b;
+	b.name = name;
+	b.func = func;
+	b.cls = cls;
+	benches.push_back(b);
+}
+
+// ---- inputs ----
+
+static unsigned int seed = 1;
+
+static float frand()
+{
+	seed = seed * 1103515245 + 12345;
+	return (float)((seed >> 8) & 0xffff) / 65535.0f;
+}
+
+static Vec3 rand_vec(float range)
+{
+	return Vec3(frand() - 0.5f, frand() - 0.5f, frand() - 0.5f) * (range * 2.0f);
+}
+
+/* rays from around the origin towards a unit area around (0, 0, -3): about
+ * half of them hit the shapes tested
+ */
+static Ray rays[NUM_INPUTS];
+static Vec3 points[NUM_INPUTS];
+static vrtk::Sphere spheres[NUM_INPUTS];
+
+static void init_inputs()
+{
+	for(int i=0; i<NUM_INPUTS; i++) {
+		Vec3 org = rand_vec(0.1f);
+		Vec3 target = Vec3(0, 0, -3) + rand_vec(1.0f);
+		rays[i] = Ray(org, normalize(target - org));
+
+		points[i] = Vec3(0, 0, -3) + rand_vec(1.0f);
+		spheres[i] = vrtk::Sphere(points[i], 0.1f + frand() * 0.2f);
+	}
+}
+
+// ---- geom.cc ----
+
+static void bench_ray_sphere(int count, void *cls)
+{
+	vrtk::Sphere sph(Vec3(0, 0, -3), 0.5f);
+	vrtk::HitPoint hit;
+	float sum = 0.0f;
+	for(int i=0; i<count; i++) {
+		if(vrtk::intersect(rays[i % NUM_INPUTS], sph, &hit)) {
+			sum += hit.t;
+		}
+	}
+	sink = sum;
+}
+
+static void bench_sphere_sphere(int count, void *cls)
+{
+	vrtk::Sphere sph(Vec3(0, 0, -3), 0.5f);
+	vrtk::HitPoint hit;
+	float sum = 0.0f;
+	for(int i=0; i<count; i++) {
+		if(vrtk::intersect(spheres[i % NUM_INPUTS], sph, &hit)) {
+			sum += hit.t;
+		}
+	}
+	sink = sum;
+}
+
+static void bench_ray_cylinder(int count, void *cls)
+{
+	vrtk::Cylinder cyl(Vec3(-0.5f, 0, -3), Vec3(0.5f, 0.2f, -3), 0.3f);
+	vrtk::HitPoint hit;
+	float sum = 0.0f;
+	for(int i=0; i<count; i++) {
+		if(vrtk::intersect(rays[i % NUM_INPUTS], cyl, &hit)) {
+			sum += hit.t;
+		}
+	}
+	sink = sum;
+}
+
+static void bench_ray_aabox(int count, void *cls)
+{
+	vrtk::AABox box(Vec3(-0.5f, -0.5f, -3.5f), Vec3(0.5f, 0.5f, -2.5f));
+	vrtk::HitPoint hit;
+	float sum = 0.0f;
+	for(int i=0; i<count; i++) {
+		if(vrtk::intersect(rays[i % NUM_INPUTS], box, &hit)) {
+			sum += hit.t;
+		}
+	}
+	sink = sum;
+}
+
+static void bench_frustum_aabox(int count, void *cls)
+{
+	// 90 degree symmetric frustum looking down -z, from 0.5 to 100
+	Mat4 proj;
+	proj[0][0] = 1.0f;
+	proj[1][1] = 1.0f;
+	proj[2][2] = -100.5f / 99.5f;
+	proj[2][3] = -1.0f;
+	proj[3][2] = -100.0f / 99.5f;
+	proj[3][3] = 0.0f;
+	vrtk::Frustum frust(proj);
+
+	int sum = 0;
+	for(int i=0; i<count; i++) {
+		const Vec3 &p = points[i % NUM_INPUTS];
+		vrtk::AABox box(p - Vec3(0.1f, 0.1f, 0.1f), p + Vec3(0.1f, 0.1f, 0.1f));
+		sum += vrtk::intersect(frust, box);
+	}
+	sink = sum;
+}
+
+static void bench_proj_point_line(int count, void *cls)
+{
+	Ray line(Vec3(-1, 0, -3), Vec3(2, 0.5f, 0));
+	float sum = 0.0f;
+	for(int i=0; i<count; i++) {
+		sum += vrtk::proj_point_line_param(points[i % NUM_INPUTS], line);
+	}
+	sink = sum;
+}
+
+// ---- ShapeCaps ----
+
+static vrtk::ShapeCaps *caps;
+
+static void bench_caps_contains(int count, void *cls)
+{
+	int sum = 0;
+	for(int i=0; i<count; i++) {
+		sum += caps->contains(points[i % NUM_INPUTS]);
+	}
+	sink = sum;
+}
+
+static void bench_caps_ray(int count, void *cls)
+{
+	vrtk::HitPoint hit;
+	float sum = 0.0f;
+	for(int i=0; i<count; i++) {
+		if(caps->intersect(rays[i % NUM_INPUTS], &hit)) {
+			sum += hit.t;
+		}
+	}
+	sink = sum;
+}
+
+static void bench_caps_sphere(int count, void *cls)
+{
+	vrtk::HitPoint hit;
+	float sum = 0.0f;
+	for(int i=0; i<count; i++) {
+		if(caps->intersect(spheres[i % NUM_INPUTS], &hit)) {
+			sum += hit.t;
+		}
+	}
+	sink = sum;
+}
+
+// ---- meshes ----
+
+/* spheres of radius 0.5 at (0, 0, -3), with usub * vsub * 2 triangles */
+static vrtk::Mesh *make_sphere(int usub, int vsub)
+{
+	vrtk::Mesh *mesh = new vrtk::Mesh;
+	vrtk::gen_sphere(mesh, 0.5f, usub, vsub);
+	Mat4 xform;
+	xform.translation(Vec3(0, 0, -3));
+	mesh->apply_xform(xform);
+	return mesh;
+}
+
+static void bench_mesh_intersect(int count, void *cls)
+{
+	const vrtk::Mesh *mesh = (const vrtk::Mesh*)cls;
+	vrtk::HitPoint hit;
+	float sum = 0.0f;
+	for(int i=0; i<count; i++) {
+		if(mesh->intersect(rays[i % NUM_INPUTS], &hit)) {
+			sum += hit.t;
+		}
+	}
+	sink = sum;
+}
+
+static void bench_mesh_clone(int count, void *cls)
+{
+	const vrtk::Mesh *mesh = (const vrtk::Mesh*)cls;
+	vrtk::Mesh dst;
+	for(int i=0; i<count; i++) {
+		dst.clone(*mesh);
+	}
+	sink = dst.get_poly_count();
+}
+
+// appending to an empty mesh is a clone, so each operation is both
+static void bench_mesh_append(int count, void *cls)
+{
+	const vrtk::Mesh *mesh = (const vrtk::Mesh*)cls;
+	vrtk::Mesh dst;
+	for(int i=0; i<count; i++) {
+		dst.clone(*mesh);
+		dst.append(*mesh);
+	}
+	sink = dst.get_poly_count();
+}
+
+static void bench_mesh_xform(int count, void *cls)
+{
+	vrtk::Mesh *mesh = (vrtk::Mesh*)cls;
+	// a rotation, so that repeating it keeps the vertices in range
+	Mat4 xform = Quat(Vec3(0, 1, 0), 0.1f).calc_matrix();
+	for(int i=0; i<count; i++) {
+		mesh->apply_xform(xform);
+	}
+	sink = mesh->get_attrib(vrtk::MESH_ATTR_VERTEX, 0).x;
+}
+
+// ---- meshgen ----
+
+enum {
+	GEN_SPHERE,
+	GEN_GEOSPHERE,
+	GEN_TORUS,
+	GEN_CYLINDER,
+	GEN_CAPSULE,
+	GEN_CONE,
+	GEN_PLANE,
+	GEN_HEIGHTMAP,
+	GEN_BOX,
+	GEN_REVOL,
+	GEN_SWEEP,
+
+	NUM_GEN
+};
+
+static const char *gen_names[] = {
+	"sphere", "geosphere", "torus", "cylinder", "capsule", "cone", "plane",
+	"heightmap", "box", "revol", "sweep"
+};
+
+struct GenParam {
+	int type;
+	int sub;	// subdivisions along u, half of that along v
+};
+
+static float hfunc(float u, float v, void *cls)
+{
+	return sin(u * 8.0f) * cos(v * 8.0f) * 0.1f;
+}
+
+static Vec2 rfunc(float u, float v, void *cls)
+{
+	return Vec2(0.5f + 0.2f * sin(v * 6.0f), v);
+}
+
+static Vec2 sfunc(float u, float v, void *cls)
+{
+	float theta = u * 2.0f * M_PI;
+	return Vec2(cos(theta), sin(theta)) * (0.5f + 0.1f * v);
+}
+
+static void bench_gen(int count, void *cls)
+{
+	const GenParam *p = (const GenParam*)cls;
+	int usub = p->sub;
+	int vsub = p->sub / 2;
+	vrtk::Mesh mesh;
+
+	for(int i=0; i<count; i++) {
+		switch(p->type) {
+		case GEN_SPHERE:
+			vrtk::gen_sphere(&mesh, 1.0f, usub, vsub);
+			break;
+		case GEN_GEOSPHERE:
+			vrtk::gen_geosphere(&mesh, 1.0f, p->sub);
+			break;
+		case GEN_TORUS:
+			vrtk::gen_torus(&mesh, 1.0f, 0.25f, usub, vsub);
+			break;
+		case GEN_CYLINDER:
+			vrtk::gen_cylinder(&mesh, 0.5f, 1.0f, usub, vsub, 2);
+			break;
+		case GEN_CAPSULE:
+			vrtk::gen_capsule(&mesh, 0.5f, 1.0f, usub, vsub);
+			break;
+		case GEN_CONE:
+			vrtk::gen_cone(&mesh, 0.5f, 1.0f, usub, vsub, 2);
+			break;
+		case GEN_PLANE:
+			vrtk::gen_plane(&mesh, 1.0f, 1.0f, usub, vsub);
+			break;
+		case GEN_HEIGHTMAP:
+			vrtk::gen_heightmap(&mesh, 1.0f, 1.0f, usub, vsub, hfunc);
+			break;
+		case GEN_BOX:
+			vrtk::gen_box(&mesh, 1.0f, 1.0f, 1.0f, usub, vsub);
+			break;
+		case GEN_REVOL:
+			vrtk::gen_revol(&mesh, usub, vsub, rfunc);
+			break;
+		case GEN_SWEEP:
+			vrtk::gen_sweep(&mesh, 1.0f, usub, vsub, sfunc);
+			break;
+		}
+	}
+	sink = mesh.get_poly_count();
+}
+
+// ---- WidgetGroup ----
+
+static void bench_group_intersect(int count, void *cls)
+{
+	const vrtk::WidgetGroup *grp = (const vrtk::WidgetGroup*)cls;
+	vrtk::HitPoint hit;
+	float sum = 0.0f;
+	for(int i=0; i<count; i++) {
+		if(grp->intersect(rays[i % NUM_INPUTS], &hit)) {
+			sum += hit.t;
+		}
+	}
+	sink = sum;
+}
+
+static void add_benches()
+{
+	char name[64];
+
+	init_inputs();
+	vrtk::set_frame_time(0);	// hidden widget checks read the frame clock
+
+	add_bench("geom/ray_sphere", bench_ray_sphere);
+	add_bench("geom/sphere_sphere", bench_sphere_sphere);
+	add_bench("geom/ray_cylinder", bench_ray_cylinder);
+	add_bench("geom/ray_aabox", bench_ray_aabox);
+	add_bench("geom/frustum_aabox", bench_frustum_aabox);
+	add_bench("geom/proj_point_line", bench_proj_point_line);
+
+	caps = new vrtk::ShapeCaps(Vec3(-0.5f, 0, -3), Vec3(0.5f, 0.2f, -3), 0.3f);
+	add_bench("caps/contains", bench_caps_contains);
+	add_bench("caps/intersect_ray", bench_caps_ray);
+	add_bench("caps/intersect_sphere", bench_caps_sphere);
+
+	static const int mesh_sub[] = {8, 16, 32, 64};
+	for(int i=0; i<4; i++) {
+		int sub = mesh_sub[i];
+		vrtk::Mesh *mesh = make_sphere(sub, sub / 2);
+		sprintf(name, "mesh/intersect/%d", mesh->get_poly_count());
+		add_bench(name, bench_mesh_intersect, mesh);
+	}
+
+	for(int i=0; i<2; i++) {
+		int sub = i ? 64 : 16;
+		vrtk::Mesh *mesh = make_sphere(sub, sub / 2);
+		int ntri = mesh->get_poly_count();
+
+		sprintf(name, "mesh/clone/%d", ntri);
+		add_bench(name, bench_mesh_clone, mesh);
+		sprintf(name, "mesh/clone_append/%d", ntri);
+		add_bench(name, bench_mesh_append, mesh);
+		sprintf(name, "mesh/apply_xform/%d", ntri);
+		add_bench(name, bench_mesh_xform, make_sphere(sub, sub / 2));
+	}
+
+	static const int gen_sub[] = {8, 32, 128};
+	static const int geosph_sub[] = {1, 2, 4};
+	for(int i=0; i<NUM_GEN; i++) {
+		for(int j=0; j<3; j++) {
+			GenParam *p = new GenParam;
+			p->type = i;
+			p->sub = i == GEN_GEOSPHERE ? geosph_sub[j] : gen_sub[j];
+			sprintf(name, "meshgen/%s/%d", gen_names[i], p->sub);
+			add_bench(name, bench_gen, p);
+		}
+	}
+
+	static const int group_size[] = {100, 1000, 10000, 100000};
+	for(int i=0; i<4; i++) {
+		sprintf(name, "group/intersect/%d", group_size[i]);
+		add_bench(name, bench_group_intersect, make_panel(group_size[i], 2.0f, 0.4f));
+	}
+}
+
+static bool parse_args(int argc, char **argv)
+{
+	for(int i=1; i<argc; i++) {
+		if(argv[i][0] == '-' && argv[i][1] && !argv[i][2]) {
+			if(!argv[i + 1]) {
+				fprintf(stderr, "%s needs an argument\n", argv[i]);
+				return false;
+			}
+			switch(argv[i][1]) {
+			case 'o':
+				out_fname = argv[++i];
+				break;
+			case 'b':
+				base_fname = argv[++i];
+				break;
+			case 't':
+				threshold = atof(argv[++i]);
+				break;
+			case 'r':
+				if((num_runs = atoi(argv[++i])) < 1) num_runs = 1;
+				break;
+			case 'm':
+				min_msec = atoi(argv[++i]);
+				break;
+			default:
+				fprintf(stderr, "invalid option: %s\n", argv[i]);
+				return false;
+			}
+		} else if(argv[i][0] != '-' && !filter) {
+			filter = argv[i];
+		} else {
+			fprintf(stderr, "unexpected argument: %s\n", argv[i]);
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool load_baseline(const char *fname)
+{
+	FILE *fp = fopen(fname, "r");
+	if(!fp) {
+		fprintf(stderr, "failed to open baseline: %s\n", fname);
+		return false;
+	}
+
+	char buf[512], name[256];
+	double median;
+	while(fgets(buf, sizeof buf, fp)) {
+		if(buf[0] == '#') continue;
+		if(sscanf(buf, "%255s %lf", name, &median) == 2 && median > 0.0) {
+			baseline[name] = median;
+		}
+	}
+	fclose(fp);
+	return true;
+}
@@ -62,6 +62,8 @@ int main(int argc, char **argv)
 
 void display()
 {
+	vrtk::advance_frame_clock();
+
 	proc_mouse();
 	proc_sball();
 
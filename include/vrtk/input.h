@@ -45,6 +45,25 @@ enum {
 };
 
 class Widget;
+class WidgetGroup;
+
+/* pointer events go to the widgets of the registered groups. Each pointer
+ * update picks the widget under the pointer once, across all groups, and
+ * sends hover events to the widgets it enters and leaves. A widget under
+ * more than one pointer gets them once, for the first to enter and the last
+ * to leave.
+ *
+ * Pressing a button over a widget grabs it, unless another pointer holds
+ * it: it gets the pointer updates as drag events, until the button is
+ * released. For ray pointers, the position dragged is the point at the
+ * distance from the origin the widget was grabbed at. While a widget is
+ * grabbed, hover stays with it.
+ *
+ * Dispatching pointer motion and button events doesn't allocate memory per
+ * event; adding pointers and groups, and recording, do.
+ */
+void input_add_group(WidgetGroup *g);
+void input_remove_group(WidgetGroup *g);
 
 /* distance threshold from initial grab that must be exceeded
  * in order to start a drag, as opposed to triggering an activation
@@ -58,10 +77,86 @@ Widget *get_keyboard_focus();
 
 void input_keyboard(int key, bool pressed);
 
+/* pointers: each has its own pose, hover, grab and button state. Pointer 0
+ * always exists, and the functions without a pointer id act on it. Hosts
+ * with more (tracked controllers, gaze) add one for each, and get its id.
+ * Removing a pointer releases whatever it holds, without activating it.
+ */
+int input_add_pointer();
+void input_remove_pointer(int ptr);
+
+/* pointer updates, which pick and send the events right away */
 void input_ray_pointer(const Vec3 &origin, const Vec3 &dir);
 void input_3d_pointer(const Vec3 &pos, const Quat &rot = Quat::identity);
+void input_ray_pointer(int ptr, const Vec3 &origin, const Vec3 &dir);
+void input_3d_pointer(int ptr, const Vec3 &pos, const Quat &rot = Quat::identity);
+
+/* batched pointer updates: the set functions only store the new poses, and
+ * input_process_pointers picks for all pointers moved since, walking the
+ * widgets of each group once for all of them, then sends the events.
+ * Poses with a timestamp (usec, non-zero) feed pose prediction, see below.
+ */
+void input_set_ray_pointer(int ptr, const Vec3 &origin, const Vec3 &dir, long long usec = 0);
+void input_set_3d_pointer(int ptr, const Vec3 &pos, const Quat &rot = Quat::identity, long long usec = 0);
+void input_process_pointers();
+
+/* pose prediction, for picking where the pointer will be when the frame
+ * reaches the display, instead of where it was when tracked. With it enabled
+ * for a pointer, its poses are extrapolated from its recent linear and
+ * angular velocity to the display time, which the host sets every frame
+ * (on the same clock as the timestamps). Only timestamped poses, from the
+ * set functions or the queue, are predicted. Off by default.
+ *
+ * horizon: how far past the last pose to extrapolate at most (default 50ms).
+ * smoothing: how much of the old velocity estimate to keep with every new
+ * pose, in [0, 1) (default 0.5). More is steadier, but lags behind changes.
+ */
+void input_set_display_time(long long usec);
+long long input_get_display_time();
+void input_set_prediction(int ptr, bool enable);
+bool input_get_prediction(int ptr);
+void input_set_prediction_horizon(int ptr, long usec);
+void input_set_prediction_smoothing(int ptr, float s);
 
+/* buttons 0 to 31 */
 void input_button(int bn, bool pressed);
+void input_button(int ptr, int bn, bool pressed);
+bool input_button_state(int ptr, int bn);
+
+/* input from another thread, such as a high rate tracking thread: the post
+ * functions queue timestamped events (usec, on any clock of the host) from
+ * that one thread without locking, and input_drain_queue dispatches them on
+ * the UI thread, typically once per frame. Consecutive motion samples of
+ * pointers are merged into the last one, but every button and key event is
+ * dispatched, in order, with the pointers where they were at the time.
+ *
+ * Single producer and single consumer: all posts must come from the same
+ * thread. Posting fails when the queue is full (4096 events).
+ */
+bool input_post_keyboard(int key, bool pressed, long long usec);
+bool input_post_ray_pointer(int ptr, const Vec3 &origin, const Vec3 &dir, long long usec);
+bool input_post_3d_pointer(int ptr, const Vec3 &pos, const Quat &rot, long long usec);
+bool input_post_button(int ptr, int bn, bool pressed, long long usec);
+int input_drain_queue();	// returns the number of events drained
+
+/* true if there are events in the queue, or pointer poses which were set but
+ * not processed yet
+ */
+bool input_pending();
+
+/* timestamp of the event being dispatched from the queue, for use in event
+ * handlers. 0 for events passed to the input functions directly.
+ */
+long long input_get_event_time();
+
+/* records every input call which affects dispatch, from here or from the
+ * queue, with its time, into a compact binary log. The input-replay tool
+ * (in bench/) plays logs back against a test scene, as fast as it can, and
+ * reports how long dispatch took.
+ */
+bool input_record_start(const char *fname);
+void input_record_stop();
+bool input_is_recording();
 
 }	// namespace vrtk
 
@@ -0,0 +1,42 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef VRTK_RENDER_H_
+#define VRTK_RENDER_H_
+
+namespace vrtk {
+
+/* vrtk keeps track of the GL state it changes while drawing, instead of
+ * querying it, and skips calls which wouldn't change anything.
+ *
+ * Call set_active_program whenever you bind a different shader program with
+ * widgets left to draw, and vrtk will never have to ask GL for it. Without
+ * it, the current program is queried once per WidgetGroup::draw. The same
+ * goes for widget draw callbacks which bind a program of their own.
+ *
+ * vrtk leaves no buffers bound and no vertex arrays enabled after drawing,
+ * and expects to find them that way. Call invalidate_gl_state if that's not
+ * the case, or after re-creating the GL context.
+ */
+void set_active_program(unsigned int prog);
+unsigned int get_active_program();
+
+void invalidate_gl_state();
+
+}	// namespace vrtk
+
+#endif	/* VRTK_RENDER_H_ */
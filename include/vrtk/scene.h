@@ -0,0 +1,64 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef VRTK_SCENE_H_
+#define VRTK_SCENE_H_
+
+namespace vrtk {
+
+/* The transformations of all widgets live in a scene-wide store. This
+ * recomputes every out of date local, world and inverse-world matrix in one
+ * batch, parents before children. WidgetGroup::draw calls it at the start
+ * of each frame.
+ */
+void update_xforms();
+
+/* BoolAnim transitions take the time from a frame clock, so that every read
+ * during a frame agrees on it. advance_frame_clock samples the monotonic
+ * system clock, and should be called once at the start of each frame.
+ * set_frame_time sets it instead, for hosts with their own frame timing.
+ * Either one also advances all BoolAnim transitions in progress, in one
+ * batch. Until either is called, the frame clock reads the system clock
+ * every time. All times are in milliseconds.
+ */
+void advance_frame_clock();
+void set_frame_time(long msec);
+long get_frame_time();
+
+/* idle detection, for hosts which skip drawing the UI, or reuse the last
+ * frame, while nothing changes. True if anything moved since the last draw,
+ * a BoolAnim transition is in progress, or input is waiting to be processed
+ * (see input_pending). This only covers scene-wide state:
+ * WidgetGroup::need_redraw also checks the group itself.
+ *
+ * next_change gets the frame time at which a scheduled transition next
+ * changes a value: the current frame time while one is in progress, or -1
+ * if none is. With nothing to redraw, hosts may sleep until then, or until
+ * new input arrives.
+ */
+bool need_redraw(long *next_change = 0);
+
+/* number of worker threads used for batch jobs on large scenes, in
+ * addition to the calling thread. Defaults to 0: no threads are created and
+ * everything runs serially.
+ */
+void set_num_threads(int n);
+int get_num_threads();
+
+}	// namespace vrtk
+
+#endif	/* VRTK_SCENE_H_ */
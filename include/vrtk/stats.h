@@ -0,0 +1,67 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef VRTK_STATS_H_
+#define VRTK_STATS_H_
+
+#include <stdio.h>
+
+namespace vrtk {
+
+/* per-frame performance counters. A frame ends whenever the frame clock is
+ * advanced (see advance_frame_clock in scene.h): its counts go into a history
+ * of the last STATS_HISTORY frames, and counting starts again from zero.
+ *
+ * Building with enable_stats off compiles the counting out; the functions
+ * below remain, and report zeros.
+ */
+enum {
+	STAT_DRAW_CALLS,
+	STAT_TRIANGLES,		// submitted for drawing, times the number of instances
+	STAT_UPLOADS,		// buffer uploads
+	STAT_UPLOAD_BYTES,
+	STAT_RAYS,			// cast by WidgetGroup::intersect
+	STAT_SHAPES_TESTED,	// shapes tested by WidgetGroup::intersect
+	STAT_TRIS_TESTED,	// triangles tested by Mesh::intersect
+	STAT_MESHES_GEN,	// meshes generated for shapes
+	STAT_ACTIVE_ANIMS,	// BoolAnim transitions in progress during the frame
+
+	NUM_STATS
+};
+
+#define STATS_HISTORY	128
+
+bool stats_enabled();
+const char *stats_name(int stat);
+
+long stats_current(int stat);	// counted so far in the current frame
+/* counts of completed frames: age 0 is the last frame, 1 the one before it,
+ * up to stats_num_frames() - 1. 0 for frames not in the history.
+ */
+long stats_frame(int stat, int age = 0);
+int stats_num_frames();
+void stats_clear();
+
+/* writes the history as JSON: an object with an array of counts per
+ * counter, oldest frame first
+ */
+bool stats_dump_json(const char *fname);
+bool stats_dump_json(FILE *fp);
+
+}	// namespace vrtk
+
+#endif	/* VRTK_STATS_H_ */
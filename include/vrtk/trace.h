@@ -0,0 +1,56 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef VRTK_TRACE_H_
+#define VRTK_TRACE_H_
+
+#include <stdio.h>
+
+namespace vrtk {
+
+/* tracing of the time spent in vrtk: drawing, picking, mesh uploads and
+ * generation, and input dispatch, per thread. Only available when vrtk is
+ * built with enable_trace; otherwise the zones are compiled out, and these
+ * functions do nothing.
+ *
+ * Each thread records into its own buffer, without locking, until it's full
+ * (65536 zones), after which further zones are dropped. Starting, stopping
+ * and dumping may be done at any time, but clear only while no vrtk calls
+ * are running on other threads.
+ */
+bool trace_available();
+
+void trace_start();
+void trace_stop();
+bool trace_is_active();
+void trace_clear();
+
+/* writes the recorded zones in the Chrome trace event format, which both
+ * chrome://tracing and Perfetto load. Timestamps are microseconds of the
+ * monotonic system clock, and threads are identified by their system thread
+ * ids, under the given process id (-1 for the id of this process), so the
+ * events line up with other traces of the same process. trace_write_events
+ * writes just the comma-separated events, for merging into another trace,
+ * and returns how many it wrote.
+ */
+bool trace_dump_json(const char *fname, int pid = -1);
+bool trace_dump_json(FILE *fp, int pid = -1);
+int trace_write_events(FILE *fp, int pid = -1);
+
+}	// namespace vrtk
+
+#endif	/* VRTK_TRACE_H_ */
@@ -19,6 +19,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define VRTK_H_
 
 #include "input.h"
+#include "scene.h"
+#include "render.h"
+#include "stats.h"
+#include "trace.h"
 
 #include "widgetgroup.h"
 
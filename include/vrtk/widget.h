@@ -18,6 +18,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef VRTK_WIDGET_H_
 #define VRTK_WIDGET_H_
 
+#include <stddef.h>
 #include <gmath/gmath.h>
 #include "boolanm.h"
 
@@ -26,16 +27,38 @@ namespace vrtk {
 class WidgetPriv;
 class Shape;
 
+/* generation-checked widget reference: resolving it after the widget has
+ * been destroyed yields null, even if its slot has been reused since.
+ */
+struct WidgetHandle {
+	unsigned int idx, gen;
+};
+
 class Widget {
 protected:
 	WidgetPriv *priv;
 
+	friend WidgetPriv *widget_priv(const Widget *w);
+
+	/* marks the local transformation of this widget, and the world
+	 * transformations of its whole subtree, as out of date.
+	 */
+	void invalidate_xform();
+	void invalidate_world_xform();
+
 public:
 	Widget();
 	Widget(const Widget&) = delete;
 	Widget &operator =(const Widget&) = delete;
 	virtual ~Widget();
 
+	// widgets are allocated from the vrtk object pools
+	static void *operator new(size_t sz);
+	static void operator delete(void *ptr, size_t sz);
+
+	WidgetHandle get_handle() const;
+	static Widget *from_handle(WidgetHandle h);
+
 	virtual void set_position(const Vec3 &pos);
 	virtual const Vec3 &get_position() const;
 	virtual void set_rotation(const Quat &rot);
@@ -43,10 +66,20 @@ public:
 	virtual void set_scaling(const Vec3 &scale);
 	virtual void set_scaling(float s);
 	virtual const Vec3 &get_scaling() const;
-	virtual const Mat4 &get_xform() const;
+	virtual const Mat4 &get_xform() const;	// local, relative to the parent
+	virtual const Mat4 &get_world_xform() const;
+	/* world to local space, for taking rays and points into shape space */
+	virtual const Mat4 &get_inv_world_xform() const;
+
+	/* recomputes any out of date world transformations in this subtree,
+	 * top-down. The getters above are correct without it, just lazier, and
+	 * update_xforms (scene.h) does the same for all widgets in one batch.
+	 */
+	void update_xform() const;
 
 	virtual Widget *get_parent() const;
 	virtual void add_child(Widget *c);
+	/* constant time, but the last child takes the place of the removed one */
 	virtual bool remove_child(Widget *c);
 	virtual int num_children() const;
 	virtual Widget *get_child(int idx) const;
@@ -54,11 +87,42 @@ public:
 	virtual void set_shape(Shape *s);
 	virtual Shape *get_shape() const;
 
+	/* world-space axis-aligned bounding box of the widget's shape, cached
+	 * until the transformation or the shape changes. Returns false if the
+	 * widget has no shape, or its shape can't be bounded.
+	 */
+	virtual bool get_bounds(Vec3 *bmin, Vec3 *bmax) const;
+
+	/* appearance: the color to draw the shape with, and an optional shader
+	 * program (0 means use whichever program the host has bound)
+	 */
+	virtual void set_color(const Vec4 &color);
+	virtual const Vec4 &get_color() const;
+	virtual void set_shader(unsigned int sdr);
+	virtual unsigned int get_shader() const;
+
+	/* WidgetGroup draws shapes through its batched render queue, and only
+	 * calls draw() for widgets with a draw function, or with shapes it can't
+	 * batch. The world transformation is already applied when it does.
+	 */
 	virtual void set_draw_func(void (*func)(const Widget*, void*), void *cls = 0);
+	virtual bool has_draw_func() const;
+
+	/* hint that this widget rarely moves or changes. Groups with static
+	 * merging enabled (see WidgetGroup::set_static_merging) pack static
+	 * widgets into shared buffers, with their transformations baked in.
+	 * Moving one still works, but re-uploads its vertices.
+	 */
+	virtual void set_static(bool s);
+	virtual bool is_static() const;
 
 	virtual void draw() const;
 
-	// ---- state ----
+	/* ---- state ----
+	 * widgets start visible, and fade in and out with the value of visible.
+	 * Changing any of these makes the group record the widget again on the
+	 * next draw, and every draw until the transition ends.
+	 */
 	virtual BoolAnim &visible();
 	virtual BoolAnim &focused();
 	virtual BoolAnim &hover();
@@ -29,17 +29,137 @@ class WidgetGroup {
 private:
 	WidgetGroupPriv *priv;
 
+	friend void mark_draw_dirty(Widget *w);
+
 public:
 	WidgetGroup();
 	~WidgetGroup();
 
+	/* A widget belongs to at most one group, which deletes it when the group
+	 * is destroyed. Adding it to another group moves it. Both are constant
+	 * time; removal moves the last widget into the place of the removed one.
+	 */
 	void add_widget(Widget *w);
 	bool remove_widget(Widget *w);
 
-	bool contains(const Vec3 &pt) const;
+	/* brings the cached world transformations of all widgets up to date,
+	 * by calling update_xforms (see scene.h). draw calls it, but hosts
+	 * picking before drawing should call it first.
+	 */
+	void update() const;
+
+	/* picking, against the shapes of the widgets, skipping hidden ones.
+	 * contains returns the first widget containing the point in wres, and
+	 * intersect the nearest widget hit in hit->obj.
+	 */
+	bool contains(const Vec3 &pt, Widget **wres = 0) const;
 	bool intersect(const Ray &ray, HitPoint *hit = 0) const;
 
+	/* batched picking, for several pointers at once: the widgets are walked
+	 * once for all of them. Misses get a null wres[i] or hits[i].obj. Both
+	 * return the number of points or rays which found a widget.
+	 */
+	int contains(int count, const Vec3 *pts, Widget **wres) const;
+	int intersect(int count, const Ray *rays, HitPoint *hits) const;
+
+	/* view-frustum culling for draw: pass the world-space view-projection
+	 * matrix of the camera, or one for each eye to cull against a single
+	 * frustum enclosing both. Culling stays off until this is called.
+	 */
+	void set_view_frustum(const Mat4 &viewproj);
+	void set_view_frustum(const Mat4 &left_viewproj, const Mat4 &right_viewproj);
+	void disable_culling();
+
+	/* packs the meshes of all static widgets (see Widget::set_static) into
+	 * shared buffers, and draws the visible ones with a single draw call.
+	 * Only widgets drawn with the host program and without a draw function
+	 * are merged. Off by default.
+	 */
+	void set_static_merging(bool enable);
+	bool get_static_merging() const;
+
+	/* draws capsule shapes without meshes, all in one instanced draw call,
+	 * as boxes in which a fragment program traces the exact capsule. Only
+	 * opaque, uniformly scaled capsules drawn with the host program and no
+	 * draw function are, and not by draw_stereo_instanced. Needs GL 3.3 or
+	 * the instanced arrays extensions, without which they're drawn as
+	 * meshes anyway. Lighting only takes light 0 into account. Off by
+	 * default.
+	 */
+	void set_capsule_impostors(bool enable);
+	bool get_capsule_impostors() const;
+
+	/* layer caching, for panels which rarely change: the group is drawn into
+	 * a texture of the given size, which is shown on a single quad facing the
+	 * viewer. It's drawn again only after a widget changes, or when the viewer
+	 * moves further than the parallax threshold from where it was drawn from:
+	 * an angle as seen from the center of the group, in radians (default 2
+	 * degrees, set after enabling). Widgets are not culled individually, only
+	 * the group as a whole.
+	 *
+	 * set_viewer must be kept up to date with the position of the viewer (the
+	 * center of the eyes for stereo). The group is drawn directly while the
+	 * viewer is inside its bounds, when instanced, and without framebuffer
+	 * objects or fixed-function GL.
+	 */
+	void set_layer_caching(bool enable, int xsz = 1024, int ysz = 1024);
+	bool get_layer_caching() const;
+	void set_layer_threshold(float angle);
+
+	/* world-space position of the viewer, for layer caching and for drawing
+	 * translucent widgets (alpha below 1, or fading with Widget::visible).
+	 * Those are drawn after the opaque ones, blended, furthest first.
+	 */
+	void set_viewer(const Vec3 &pos);
+
+	/* drawing is done in two stages. record walks the widgets, culls them,
+	 * and builds a sorted draw list, without making any GL calls: it may run
+	 * on any thread, and splits large groups across the worker threads (see
+	 * set_num_threads in scene.h). submit draws the recorded list on the GL
+	 * thread, and may be called more than once for the same list, for
+	 * instance once per eye. Widgets must not change in between.
+	 *
+	 * The draw list is kept between frames: record only redoes the widgets
+	 * which changed since the last call (moved, changed shape or appearance,
+	 * or changed state, see Widget::visible and friends), and culls
+	 * everything again only when the view frustum changes. Hidden widgets
+	 * are not drawn.
+	 *
+	 * Meshes are drawn with the given number of instances; see
+	 * draw_stereo_instanced below.
+	 *
+	 * draw is record followed by submit.
+	 */
+	void record() const;
+	void submit(int instances = 1) const;
 	void draw() const;
+
+	/* stereo drawing, for VR. Both walk the widgets, cull (against the
+	 * frustum enclosing both eyes, see set_view_frustum) and sort only once.
+	 *
+	 * draw_stereo calls setup_eye with eye 0 (left) and 1 (right), which
+	 * should set up the viewport or render target and the matrices for that
+	 * eye, and draws everything after each call.
+	 *
+	 * draw_stereo_instanced draws everything once, with two instances per
+	 * draw call. It's for host programs which select the eye by instance id,
+	 * into a layered or side by side target. Widgets with draw functions are
+	 * called once, and need to handle both eyes themselves.
+	 */
+	void draw_stereo(void (*setup_eye)(int eye, void *cls), void *cls = 0) const;
+	void draw_stereo_instanced() const;
+
+	/* true if drawing the group again would draw anything differently than
+	 * the last time: a widget changed since the last record, culling
+	 * changed, or the layer needs rendering again. Also includes the
+	 * scene-wide checks, and fills in next_change, as need_redraw in scene.h
+	 * does.
+	 */
+	bool need_redraw(long *next_change = 0) const;
+
+	// number of widgets drawn and culled by the last call to draw
+	int get_num_visible() const;
+	int get_num_culled() const;
 };
 
 
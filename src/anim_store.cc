@@ -0,0 +1,291 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "anim_store.h"
+#include "boolanm.h"
+
+namespace vrtk {
+
+#define DEF_DURATION	500
+
+static inline float apply_ease(int ease, float t);
+
+AnimStore *get_anim_store()
+{
+	// intentionally never destroyed: widgets may be deleted during static destruction
+	static AnimStore *store = new AnimStore;
+	return store;
+}
+
+AnimStore::AnimStore()
+{
+	update_time = -1;
+	changed = false;
+}
+
+int AnimStore::alloc()
+{
+	int slot;
+	if(!free_slots.empty()) {
+		slot = free_slots.back();
+		free_slots.pop_back();
+	} else {
+		slot = value.size();
+		value.push_back(0.0f);
+		dir.push_back(0.0f);
+		start.push_back(0);
+		dur.push_back(0);
+		ease.push_back(0);
+		active_idx.push_back(-1);
+	}
+
+	value[slot] = 0.0f;
+	dir[slot] = 0.0f;
+	start[slot] = 0;
+	dur[slot] = DEF_DURATION;
+	ease[slot] = BoolAnim::EASE_LINEAR;
+	active_idx[slot] = -1;
+	return slot;
+}
+
+void AnimStore::free(int slot)
+{
+	if(active_idx[slot] >= 0) {
+		remove_active(active_idx[slot]);
+	}
+	free_slots.push_back(slot);
+}
+
+void AnimStore::copy(int dst, int src)
+{
+	if(active_idx[dst] >= 0) {
+		remove_active(active_idx[dst]);
+	}
+	value[dst] = value[src];
+	dir[dst] = dir[src];
+	start[dst] = start[src];
+	dur[dst] = dur[src];
+	ease[dst] = ease[src];
+	if(active_idx[src] >= 0) {
+		add_active(dst);
+	}
+}
+
+void AnimStore::add_active(int slot)
+{
+	if(active_idx[slot] < 0) {
+		active_idx[slot] = act_slot.size();
+		act_slot.push_back(slot);
+		act_start.push_back(0);
+		act_rate.push_back(0.0f);
+		act_t.push_back(0.0f);
+	}
+	int idx = active_idx[slot];
+	act_start[idx] = start[slot];
+	act_rate[idx] = 1.0f / (float)dur[slot];
+}
+
+// constant time, the last transition takes the place of the removed one
+void AnimStore::remove_active(int idx)
+{
+	int last = act_slot.size() - 1;
+	active_idx[act_slot[idx]] = -1;
+	if(idx != last) {
+		act_slot[idx] = act_slot[last];
+		act_start[idx] = act_start[last];
+		act_rate[idx] = act_rate[last];
+		act_t[idx] = act_t[last];
+		active_idx[act_slot[idx]] = idx;
+	}
+	act_slot.pop_back();
+	act_start.pop_back();
+	act_rate.pop_back();
+	act_t.pop_back();
+}
+
+// brings the cached value of a changed slot to the time of the last update
+void AnimStore::refresh(int slot)
+{
+	float d;
+	value[slot] = eval(slot, update_time, &d);
+	if(d == 0.0f) {
+		dir[slot] = 0.0f;
+		if(active_idx[slot] >= 0) {
+			remove_active(active_idx[slot]);
+		}
+	}
+}
+
+void AnimStore::set(int slot, bool st)
+{
+	if(active_idx[slot] >= 0) {
+		remove_active(active_idx[slot]);
+	}
+	value[slot] = st ? 1.0f : 0.0f;
+	dir[slot] = 0.0f;
+}
+
+void AnimStore::start_transition(int slot, bool st, long tm)
+{
+	if(dur[slot] <= 0) {
+		set(slot, st);
+		return;
+	}
+	dir[slot] = st ? 1.0f : -1.0f;
+	start[slot] = tm;
+	add_active(slot);
+	refresh(slot);
+}
+
+void AnimStore::set_duration(int slot, long d)
+{
+	dur[slot] = d;
+	if(active_idx[slot] >= 0) {
+		if(d <= 0) {
+			set(slot, dir[slot] > 0.0f);
+		} else {
+			add_active(slot);
+			refresh(slot);
+		}
+	}
+}
+
+long AnimStore::get_duration(int slot) const
+{
+	return dur[slot];
+}
+
+void AnimStore::set_easing(int slot, int e)
+{
+	ease[slot] = e;
+	if(active_idx[slot] >= 0) {
+		refresh(slot);
+	}
+}
+
+int AnimStore::get_easing(int slot) const
+{
+	return ease[slot];
+}
+
+float AnimStore::eval(int slot, long tm, float *dir_ret) const
+{
+	float d = dir[slot];
+	if(d == 0.0f) {
+		if(dir_ret) *dir_ret = 0.0f;
+		return value[slot];
+	}
+
+	float t = (float)(tm - start[slot]) / (float)dur[slot];
+	if(t < 0.0f) t = 0.0f;
+	if(t >= 1.0f) {
+		// ended by then
+		if(dir_ret) *dir_ret = 0.0f;
+		return d > 0.0f ? 1.0f : 0.0f;
+	}
+
+	if(dir_ret) *dir_ret = d;
+	t = apply_ease(ease[slot], t);
+	return d > 0.0f ? t : 1.0f - t;
+}
+
+void AnimStore::update(long tm)
+{
+	update_time = tm;
+
+	int num = act_slot.size();
+	changed = false;
+	if(!num) return;
+
+	// transition parameter of all active slots, branchless so that it vectorizes
+	const long *sp = &act_start[0];
+	const float *rp = &act_rate[0];
+	float *tp = &act_t[0];
+	for(int i=0; i<num; i++) {
+		float t = (float)(tm - sp[i]) * rp[i];
+		t = t < 0.0f ? 0.0f : t;
+		tp[i] = t > 1.0f ? 1.0f : t;
+	}
+
+	int i = 0;
+	while(i < num) {
+		int slot = act_slot[i];
+		float t = act_t[i];
+		float d = dir[slot];
+
+		if(t >= 1.0f) {
+			value[slot] = d > 0.0f ? 1.0f : 0.0f;
+			dir[slot] = 0.0f;
+			remove_active(i);	// the last one moves here, and gets its turn
+			num--;
+			changed = true;
+			continue;
+		}
+
+		// transitions scheduled for later haven't changed anything yet
+		if(t > 0.0f) {
+			changed = true;
+		}
+
+		t = apply_ease(ease[slot], t);
+		value[slot] = d > 0.0f ? t : 1.0f - t;
+		i++;
+	}
+}
+
+int AnimStore::num_active() const
+{
+	return (int)act_slot.size();
+}
+
+long AnimStore::next_change(long tm) const
+{
+	if(changed) {
+		return tm;	// the values of the last update may not have been drawn yet
+	}
+
+	long next = -1;
+
+	int num = act_slot.size();
+	for(int i=0; i<num; i++) {
+		long st = act_start[i];
+		if(st <= tm) {
+			return tm;
+		}
+		if(next < 0 || st < next) {
+			next = st;
+		}
+	}
+	return next;
+}
+
+static inline float apply_ease(int ease, float t)
+{
+	switch(ease) {
+	case BoolAnim::EASE_SMOOTH:
+		return t * t * (3.0f - 2.0f * t);
+	case BoolAnim::EASE_IN:
+		return t * t;
+	case BoolAnim::EASE_OUT:
+		return t * (2.0f - t);
+	default:
+		break;
+	}
+	return t;
+}
+
+}	// namespace vrtk
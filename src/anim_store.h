@@ -0,0 +1,111 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef ANIM_STORE_H_
+#define ANIM_STORE_H_
+
+#include <vector>
+
+namespace vrtk {
+
+/* State of all BoolAnims, one slot each, with each attribute stored
+ * contiguously. The transitions in progress are kept in a separate compact
+ * list, which update advances in one pass per frame, and the values it
+ * computes are what BoolAnims read during the frame.
+ *
+ * The cached value and direction of every slot are always those at the time
+ * of the last update: changes in between recompute them for that time.
+ */
+class AnimStore {
+private:
+	std::vector<float> value;
+	std::vector<float> dir;		// transition direction: -1, 0 or 1
+	std::vector<long> start, dur;
+	std::vector<unsigned char> ease;
+	std::vector<int> active_idx;	// index in the active list, or -1
+	std::vector<int> free_slots;
+
+	// transitions in progress
+	std::vector<int> act_slot;
+	std::vector<long> act_start;
+	std::vector<float> act_rate;	// 1 / duration
+	std::vector<float> act_t;
+
+	long update_time;
+	bool changed;	// the last update changed any values
+
+	void add_active(int slot);
+	void remove_active(int idx);
+	void refresh(int slot);
+
+public:
+	AnimStore();
+
+	int alloc();
+	void free(int slot);
+	void copy(int dst, int src);
+
+	void set(int slot, bool st);
+	void start_transition(int slot, bool st, long tm);
+
+	void set_duration(int slot, long dur);
+	long get_duration(int slot) const;
+	void set_easing(int slot, int ease);
+	int get_easing(int slot) const;
+
+	// value and direction at any time, computed without updating anything
+	float eval(int slot, long tm, float *dir = 0) const;
+
+	// as of the last update, see get_update_time
+	inline float get_value(int slot) const;
+	inline float get_dir(int slot) const;
+	inline long get_update_time() const;
+
+	/* advances all transitions in progress to time tm, and drops the ones
+	 * which ended from the active list
+	 */
+	void update(long tm);
+
+	int num_active() const;
+	/* the time a transition next changes a value at or after tm: tm itself
+	 * if any is in progress or the last update changed anything, or the
+	 * start of the earliest scheduled for later. -1 if there are none.
+	 */
+	long next_change(long tm) const;
+};
+
+/* the animation store used by all BoolAnims */
+AnimStore *get_anim_store();
+
+inline float AnimStore::get_value(int slot) const
+{
+	return value[slot];
+}
+
+inline float AnimStore::get_dir(int slot) const
+{
+	return dir[slot];
+}
+
+inline long AnimStore::get_update_time() const
+{
+	return update_time;
+}
+
+}	// namespace vrtk
+
+#endif	// ANIM_STORE_H_
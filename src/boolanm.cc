@@ -19,47 +19,64 @@ You should have received a copy of the GNU Lesser General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "boolanm.h"
+#include "anim_store.h"
+#include "frame_clock.h"
 
-static long default_get_msec();
+using namespace vrtk;
 
 BoolAnim::BoolAnim(bool st)
 {
+	slot = get_anim_store()->alloc();
+	change_func = 0;
+	change_cls = 0;
+	get_msec = frame_msec;
 	set(st);
-	trans_start = 0;
-	trans_dur = 500;
-	get_msec = default_get_msec;
 }
 
-void BoolAnim::update(long tm) const
+BoolAnim::BoolAnim(const BoolAnim &anim)
 {
-	if(trans_dir == 0.0) return;
-
-	float dt = (tm - trans_start) / 1000.0;
-	float t = dt / (trans_dur / 1000.0);
+	slot = get_anim_store()->alloc();
+	change_func = 0;
+	change_cls = 0;
+	get_msec = anim.get_msec;
+	get_anim_store()->copy(slot, anim.slot);
+}
 
-	if(trans_dir > 0.0) {
-		value = t;
-	} else {
-		value = 1.0 - t;
-	}
+BoolAnim::~BoolAnim()
+{
+	get_anim_store()->free(slot);
+}
 
-	if(value < 0.0) {
-		value = 0.0;
-		trans_dir = 0.0;
-	} else if(value > 1.0) {
-		value = 1.0;
-		trans_dir = 0.0;
+BoolAnim &BoolAnim::operator =(const BoolAnim &anim)
+{
+	if(&anim != this) {
+		get_anim_store()->copy(slot, anim.slot);
+		get_msec = anim.get_msec;
+		if(change_func) {
+			change_func(this, change_cls);
+		}
 	}
+	return *this;
 }
 
 void BoolAnim::set_transition_duration(long dur)
 {
-	trans_dur = dur;
+	get_anim_store()->set_duration(slot, dur);
 }
 
 long BoolAnim::get_transition_duration() const
 {
-	return trans_dur;
+	return get_anim_store()->get_duration(slot);
+}
+
+void BoolAnim::set_easing(int ease)
+{
+	get_anim_store()->set_easing(slot, ease);
+}
+
+int BoolAnim::get_easing() const
+{
+	return get_anim_store()->get_easing(slot);
 }
 
 void BoolAnim::set_time_callback(long (*time_func)())
@@ -67,10 +84,24 @@ void BoolAnim::set_time_callback(long (*time_func)())
 	get_msec = time_func;
 }
 
+void BoolAnim::set_change_callback(void (*func)(BoolAnim*, void*), void *cls)
+{
+	change_func = func;
+	change_cls = cls;
+}
+
 void BoolAnim::set(bool st)
 {
-	value = st ? 1.0 : 0.0;
-	trans_dir = 0.0;
+	get_anim_store()->set(slot, st);
+	if(change_func) {
+		change_func(this, change_cls);
+	}
+}
+
+BoolAnim &BoolAnim::operator =(bool st)
+{
+	set(st);
+	return *this;
 }
 
 void BoolAnim::change(bool st)
@@ -80,48 +111,70 @@ void BoolAnim::change(bool st)
 
 void BoolAnim::change(bool st, long tm)
 {
-	trans_dir = st ? 1.0 : -1.0;
-	trans_start = tm;
+	get_anim_store()->start_transition(slot, st, tm);
+	if(change_func) {
+		change_func(this, change_cls);
+	}
 }
 
-bool BoolAnim::get_state() const
+static inline bool calc_state(float val, float dir)
 {
-	return get_state(get_msec());
+	// if we're not in transition use the value (should be 0 or 1)
+	if(dir == 0.0f) {
+		return val > 0.5f;
+	}
+
+	// if we're in transition base it on the direction of the transition
+	return dir > 0.0f;
 }
 
-bool BoolAnim::get_state(long tm) const
+bool BoolAnim::get_state() const
 {
-	update(tm);
-
-	// if we're not in transition use the value (should be 0 or 1)
-	if(trans_dir == 0.0) {
-		return value > 0.5;
+	AnimStore *store = get_anim_store();
+	long tm = get_msec();
+	if(tm == store->get_update_time()) {
+		return calc_state(store->get_value(slot), store->get_dir(slot));
 	}
+	return get_state(tm);
+}
 
-	// if we're in transition base it on the direction of the transition
-	return trans_dir > 0.0;
+bool BoolAnim::get_state(long tm) const
+{
+	float dir;
+	float val = get_anim_store()->eval(slot, tm, &dir);
+	return calc_state(val, dir);
 }
 
 float BoolAnim::get_value() const
 {
-	return get_value(get_msec());
+	AnimStore *store = get_anim_store();
+	long tm = get_msec();
+	if(tm == store->get_update_time()) {
+		return store->get_value(slot);
+	}
+	return store->eval(slot, tm);
 }
 
 float BoolAnim::get_value(long tm) const
 {
-	update(tm);
-	return value;
+	return get_anim_store()->eval(slot, tm);
 }
 
 float BoolAnim::get_dir() const
 {
-	return get_dir(get_msec());
+	AnimStore *store = get_anim_store();
+	long tm = get_msec();
+	if(tm == store->get_update_time()) {
+		return store->get_dir(slot);
+	}
+	return get_dir(tm);
 }
 
 float BoolAnim::get_dir(long tm) const
 {
-	update(tm);
-	return trans_dir;
+	float dir;
+	get_anim_store()->eval(slot, tm, &dir);
+	return dir;
 }
 
 BoolAnim::operator bool() const
@@ -133,27 +186,3 @@ BoolAnim::operator float() const
 {
 	return get_value();
 }
-
-#ifdef WIN32
-#include <windows.h>
-
-static long default_get_msec()
-{
-	return GetTickCount();
-}
-#else
-#include <sys/time.h>
-
-static long default_get_msec()
-{
-	static struct timeval tv0;
-	struct timeval tv;
-
-	gettimeofday(&tv, 0);
-	if(tv0.tv_sec == 0 && tv0.tv_usec == 0) {
-		tv0 = tv;
-		return 0;
-	}
-	return (tv.tv_sec - tv0.tv_sec) * 1000 + (tv.tv_usec - tv0.tv_usec) / 1000;
-}
-#endif
@@ -21,30 +21,59 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef BOOLANIM_H_
 #define BOOLANIM_H_
 
+/* A boolean state with timed transitions between its two values. The state
+ * of all BoolAnims lives in the vrtk animation store, which advances those in
+ * transition once per frame (see advance_frame_clock in scene.h); a BoolAnim
+ * is a handle to its slot there.
+ */
 class BoolAnim {
 private:
-	mutable float value;
-	mutable float trans_dir;	// transition direction (sign)
-	long trans_start;	// transition start time
-	long trans_dur;
+	int slot;	// in the animation store
 
 	long (*get_msec)();
 
-	void update(long tm) const;
+	void (*change_func)(BoolAnim*, void*);
+	void *change_cls;
 
 public:
+	// easing curves, applied to the progress of transitions
+	enum {
+		EASE_LINEAR,
+		EASE_SMOOTH,	// smoothstep
+		EASE_IN,		// quadratic, slow start
+		EASE_OUT		// quadratic, slow end
+	};
+
 	BoolAnim(bool st = false);
+	BoolAnim(const BoolAnim &anim);	// copies the state, not the callbacks
+	~BoolAnim();
+	BoolAnim &operator =(const BoolAnim &anim);
 
 	void set_transition_duration(long dur);
 	long get_transition_duration() const;
 
+	void set_easing(int ease);
+	int get_easing() const;
+
+	/* the default time source is the vrtk frame clock (advance_frame_clock
+	 * in scene.h), in milliseconds
+	 */
 	void set_time_callback(long (*time_func)());
 
+	/* called whenever the state is set or a transition starts, not on
+	 * every value change during a transition
+	 */
+	void set_change_callback(void (*func)(BoolAnim *anim, void *cls), void *cls = 0);
+
 	void set(bool st);
+	BoolAnim &operator =(bool st);	// equivalent to set, keeps the callbacks
 
 	void change(bool st);
 	void change(bool st, long trans_start);
 
+	/* without a time argument, these read the values computed by the last
+	 * update of the animation store, if it was for the current time
+	 */
 	bool get_state() const;
 	bool get_state(long tm) const;
 
@@ -17,19 +17,21 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "button.h"
 #include "shape_caps.h"
+#include "pool.h"
 
 namespace vrtk {
 
-class ButtonPriv {
+class ButtonPriv : public PoolObject {
 public:
+	ShapeCaps shape;
 };
 
 Button::Button()
 {
 	priv = new ButtonPriv;
 
-	ShapeCaps *shape = new ShapeCaps(Vec3(-1, 0, 0), Vec3(1, 0, 0), 0.5);
-	set_shape(shape);
+	priv->shape.set_capsule(Vec3(-1, 0, 0), Vec3(1, 0, 0), 0.5);
+	set_shape(&priv->shape);
 }
 
 Button::~Button()
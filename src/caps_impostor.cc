@@ -0,0 +1,350 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stddef.h>
+#include "opengl.h"
+#include "caps_impostor.h"
+#include "glstate.h"
+#include "stats_priv.h"
+
+namespace vrtk {
+
+enum {
+	ATTR_CORNER,	// generic attribute 0 stands in for gl_Vertex
+	ATTR_END0,
+	ATTR_END1,
+	ATTR_COLOR
+};
+
+/* the box spans the capsule along its axis, and its radius across. Drawing
+ * the back faces keeps it working with the viewer inside the box.
+ */
+static const char *vsrc =
+	"#version 120\n"
+	"attribute vec3 attr_corner;\n"
+	"attribute vec4 attr_end0;\n"
+	"attribute vec3 attr_end1;\n"
+	"attribute vec4 attr_color;\n"
+	"varying vec3 vpos, vend0, vend1;\n"
+	"varying float vrad;\n"
+	"varying vec4 vcolor;\n"
+	"void main()\n"
+	"{\n"
+	"	vec3 a = attr_end0.xyz;\n"
+	"	vec3 b = attr_end1;\n"
+	"	float r = attr_end0.w;\n"
+	"	vec3 axis = b - a;\n"
+	"	float len = length(axis);\n"
+	"	vec3 u = len > 0.0 ? axis / len : vec3(1.0, 0.0, 0.0);\n"
+	"	vec3 v = normalize(cross(u, abs(u.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0)));\n"
+	"	vec3 w = cross(u, v);\n"
+	"	vec3 p = (a + b) * 0.5 + u * (attr_corner.x * (len * 0.5 + r)) +\n"
+	"		v * (attr_corner.y * r) + w * (attr_corner.z * r);\n"
+	"	vec4 view = gl_ModelViewMatrix * vec4(p, 1.0);\n"
+	"	vpos = view.xyz;\n"
+	"	vend0 = (gl_ModelViewMatrix * vec4(a, 1.0)).xyz;\n"
+	"	vend1 = (gl_ModelViewMatrix * vec4(b, 1.0)).xyz;\n"
+	"	vrad = r * length(gl_ModelViewMatrix[0].xyz);\n"
+	"	vcolor = attr_color;\n"
+	"	gl_Position = gl_ProjectionMatrix * view;\n"
+	"}\n";
+
+/* ray-capsule intersection in view space: the nearest of the hits on the
+ * cylinder between the ends, and on the spheres around them
+ */
+static const char *psrc =
+	"#version 120\n"
+	"uniform bool lighting;\n"
+	"varying vec3 vpos, vend0, vend1;\n"
+	"varying float vrad;\n"
+	"varying vec4 vcolor;\n"
+	"#define NO_HIT	1e20\n"
+	"float sphere_hit(vec3 ro, vec3 rd, vec3 c)\n"
+	"{\n"
+	"	vec3 oc = ro - c;\n"
+	"	float b = dot(oc, rd);\n"
+	"	float h = b * b - dot(oc, oc) + vrad * vrad;\n"
+	"	if(h < 0.0) return NO_HIT;\n"
+	"	float t = -b - sqrt(h);\n"
+	"	return t > 0.0 ? t : NO_HIT;\n"
+	"}\n"
+	"void main()\n"
+	"{\n"
+	"	vec3 ro, rd;\n"
+	"	if(gl_ProjectionMatrix[3][3] == 0.0) {\n"
+	"		ro = vec3(0.0);\n"
+	"		rd = normalize(vpos);\n"
+	"	} else {\n"
+	"		rd = vec3(0.0, 0.0, -1.0);\n"
+	"		ro = vec3(vpos.xy, max(vend0.z, vend1.z) + vrad + 1.0);\n"
+	"	}\n"
+	"	vec3 ba = vend1 - vend0;\n"
+	"	vec3 oa = ro - vend0;\n"
+	"	float baba = dot(ba, ba);\n"
+	"	float bard = dot(ba, rd);\n"
+	"	float baoa = dot(ba, oa);\n"
+	"	float t = NO_HIT;\n"
+	"	float a = baba - bard * bard;\n"
+	"	if(a > 1e-6 * baba) {\n"
+	"		float b = baba * dot(rd, oa) - baoa * bard;\n"
+	"		float c = baba * dot(oa, oa) - baoa * baoa - vrad * vrad * baba;\n"
+	"		float h = b * b - a * c;\n"
+	"		if(h >= 0.0) {\n"
+	"			float tc = (-b - sqrt(h)) / a;\n"
+	"			float y = baoa + tc * bard;\n"
+	"			if(tc > 0.0 && y > 0.0 && y < baba) t = tc;\n"
+	"		}\n"
+	"	}\n"
+	"	t = min(t, min(sphere_hit(ro, rd, vend0), sphere_hit(ro, rd, vend1)));\n"
+	"	if(t >= NO_HIT) discard;\n"
+	"\n"
+	"	vec3 p = ro + rd * t;\n"
+	"	vec4 clip = gl_ProjectionMatrix * vec4(p, 1.0);\n"
+	"	gl_FragDepth = (gl_DepthRange.diff * clip.z / clip.w + gl_DepthRange.near + gl_DepthRange.far) * 0.5;\n"
+	"\n"
+	"	vec4 color = vcolor;\n"
+	"	if(lighting) {\n"
+	"		float s = baba > 0.0 ? clamp(dot(p - vend0, ba) / baba, 0.0, 1.0) : 0.0;\n"
+	"		vec3 n = normalize(p - (vend0 + ba * s));\n"
+	"		vec4 lpos = gl_LightSource[0].position;\n"
+	"		vec3 ldir = normalize(lpos.xyz - p * lpos.w);\n"
+	"		color.rgb *= gl_LightModel.ambient.rgb + gl_LightSource[0].ambient.rgb +\n"
+	"			gl_LightSource[0].diffuse.rgb * max(dot(n, ldir), 0.0);\n"
+	"	}\n"
+	"	gl_FragColor = color;\n"
+	"}\n";
+
+static const float box_verts[] = {
+	-1, -1, -1,		1, -1, -1,		-1, 1, -1,		1, 1, -1,
+	-1, -1, 1,		1, -1, 1,		-1, 1, 1,		1, 1, 1
+};
+
+// outward facing, counter-clockwise
+static const unsigned short box_idx[] = {
+	0, 4, 6, 0, 6, 2,	1, 3, 7, 1, 7, 5,
+	0, 1, 5, 0, 5, 4,	2, 6, 7, 2, 7, 3,
+	0, 2, 3, 0, 3, 1,	4, 5, 7, 4, 7, 6
+};
+
+CapsImpostors::CapsImpostors()
+{
+	inst_dirty = false;
+	gl_status = 0;
+	prog = 0;
+	lighting_loc = -1;
+	box_vbo = box_ibo = inst_vbo = 0;
+	inst_vbo_size = 0;
+}
+
+CapsImpostors::~CapsImpostors()
+{
+	if(gl_status > 0) {
+		unsigned int bufs[] = {box_vbo, box_ibo, inst_vbo};
+		gl_delete_buffers(inst_vbo ? 3 : 2, bufs);
+		gl_delete_program(prog);
+	}
+}
+
+void CapsImpostors::clear()
+{
+	inst.clear();
+	inst_dirty = true;
+}
+
+void CapsImpostors::add(const Vec3 &a, const Vec3 &b, float rad, unsigned int color)
+{
+	Instance in;
+	in.end0[0] = a.x;
+	in.end0[1] = a.y;
+	in.end0[2] = a.z;
+	in.end0[3] = rad;
+	in.end1[0] = b.x;
+	in.end1[1] = b.y;
+	in.end1[2] = b.z;
+	for(int i=0; i<4; i++) {
+		in.color[i] = (color >> (24 - i * 8)) & 0xff;
+	}
+	inst.push_back(in);
+	inst_dirty = true;
+}
+
+int CapsImpostors::size() const
+{
+	return (int)inst.size();
+}
+
+#ifndef GL_ES_VERSION_2_0
+static bool have_instancing()
+{
+	const char *ver = (const char*)glGetString(GL_VERSION);
+	const char *ext = (const char*)glGetString(GL_EXTENSIONS);
+
+	if(ver && atof(ver) >= 3.3) {
+		return true;
+	}
+	return ext && strstr(ext, "GL_ARB_instanced_arrays") && strstr(ext, "GL_ARB_draw_instanced");
+}
+
+static unsigned int compile_shader(unsigned int type, const char *src)
+{
+	unsigned int sdr = glCreateShader(type);
+	glShaderSource(sdr, 1, &src, 0);
+	glCompileShader(sdr);
+
+	int status;
+	glGetShaderiv(sdr, GL_COMPILE_STATUS, &status);
+	if(!status) {
+		char buf[512];
+		glGetShaderInfoLog(sdr, sizeof buf, 0, buf);
+		fprintf(stderr, "vrtk: failed to compile capsule impostor shader:\n%s\n", buf);
+		glDeleteShader(sdr);
+		return 0;
+	}
+	return sdr;
+}
+#endif
+
+bool CapsImpostors::init_gl()
+{
+	if(gl_status) {
+		return gl_status > 0;
+	}
+	gl_status = -1;
+
+#ifndef GL_ES_VERSION_2_0
+	if(!have_instancing()) {
+		return false;
+	}
+
+	unsigned int vs = compile_shader(GL_VERTEX_SHADER, vsrc);
+	unsigned int ps = compile_shader(GL_FRAGMENT_SHADER, psrc);
+	if(!vs || !ps) {
+		if(vs) glDeleteShader(vs);
+		if(ps) glDeleteShader(ps);
+		return false;
+	}
+
+	prog = glCreateProgram();
+	glAttachShader(prog, vs);
+	glAttachShader(prog, ps);
+	glBindAttribLocation(prog, ATTR_CORNER, "attr_corner");
+	glBindAttribLocation(prog, ATTR_END0, "attr_end0");
+	glBindAttribLocation(prog, ATTR_END1, "attr_end1");
+	glBindAttribLocation(prog, ATTR_COLOR, "attr_color");
+	glLinkProgram(prog);
+	// the program keeps them alive
+	glDeleteShader(vs);
+	glDeleteShader(ps);
+
+	int status;
+	glGetProgramiv(prog, GL_LINK_STATUS, &status);
+	if(!status) {
+		fprintf(stderr, "vrtk: failed to link the capsule impostor program\n");
+		glDeleteProgram(prog);
+		prog = 0;
+		return false;
+	}
+	lighting_loc = glGetUniformLocation(prog, "lighting");
+
+	unsigned int bufs[2];
+	glGenBuffers(2, bufs);
+	box_vbo = bufs[0];
+	box_ibo = bufs[1];
+
+	gl_bind_vertex_array(0);	// don't disturb the binding of a VAO
+	gl_bind_buffer(GL_ARRAY_BUFFER, box_vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof box_verts, box_verts, GL_STATIC_DRAW);
+	gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, box_ibo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof box_idx, box_idx, GL_STATIC_DRAW);
+
+	gl_status = 1;
+	return true;
+#else
+	return false;
+#endif
+}
+
+void CapsImpostors::upload()
+{
+	if(!inst_vbo) {
+		glGenBuffers(1, &inst_vbo);
+	}
+	gl_bind_buffer(GL_ARRAY_BUFFER, inst_vbo);
+
+	int count = inst.size();
+	if(count > inst_vbo_size) {
+		inst_vbo_size = inst.capacity();
+		glBufferData(GL_ARRAY_BUFFER, inst_vbo_size * sizeof(Instance), 0, GL_DYNAMIC_DRAW);
+	}
+	glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(Instance), &inst[0]);
+	inst_dirty = false;
+	STAT_ADD(STAT_UPLOADS, 1);
+	STAT_ADD(STAT_UPLOAD_BYTES, count * sizeof(Instance));
+}
+
+void CapsImpostors::draw()
+{
+#ifndef GL_ES_VERSION_2_0
+	if(inst.empty() || !init_gl()) return;
+
+	gl_bind_vertex_array(0);
+	if(inst_dirty) {
+		upload();
+	}
+
+	unsigned int host_sdr = gl_current_program();
+	gl_use_program(prog);
+	glUniform1i(lighting_loc, glIsEnabled(GL_LIGHTING));
+
+	glPushAttrib(GL_ENABLE_BIT | GL_POLYGON_BIT);
+	glEnable(GL_CULL_FACE);
+	glCullFace(GL_FRONT);
+
+	int stride = sizeof(Instance);
+	gl_bind_buffer(GL_ARRAY_BUFFER, box_vbo);
+	glVertexAttribPointer(ATTR_CORNER, 3, GL_FLOAT, GL_FALSE, 0, 0);
+	gl_bind_buffer(GL_ARRAY_BUFFER, inst_vbo);
+	glVertexAttribPointer(ATTR_END0, 4, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Instance, end0));
+	glVertexAttribPointer(ATTR_END1, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Instance, end1));
+	glVertexAttribPointer(ATTR_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)offsetof(Instance, color));
+	gl_set_client_arrays(0);
+	gl_set_attrib_arrays((1 << ATTR_CORNER) | (1 << ATTR_END0) | (1 << ATTR_END1) | (1 << ATTR_COLOR));
+
+	// the divisors aren't part of the shadowed state, so they're put back
+	for(int i=ATTR_END0; i<=ATTR_COLOR; i++) {
+		glVertexAttribDivisor(i, 1);
+	}
+
+	gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, box_ibo);
+	glDrawElementsInstanced(GL_TRIANGLES, sizeof box_idx / sizeof *box_idx, GL_UNSIGNED_SHORT, 0, inst.size());
+	STAT_ADD(STAT_DRAW_CALLS, 1);
+	STAT_ADD(STAT_TRIANGLES, (long)(sizeof box_idx / sizeof *box_idx / 3) * inst.size());
+
+	for(int i=ATTR_END0; i<=ATTR_COLOR; i++) {
+		glVertexAttribDivisor(i, 0);
+	}
+
+	glPopAttrib();
+	gl_reset_arrays();
+	gl_use_program(host_sdr);
+#endif
+}
+
+}	// namespace vrtk
@@ -0,0 +1,70 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef CAPS_IMPOSTOR_H_
+#define CAPS_IMPOSTOR_H_
+
+#include <vector>
+#include <gmath/gmath.h>
+
+namespace vrtk {
+
+/* Capsules drawn without meshes: each one is an instance of a box enclosing
+ * it, and a fragment program ray-traces the exact capsule in the box, and
+ * writes its depth. One instanced draw call for all of them, with the world
+ * positions of the ends, the radius and the color as per-instance attributes.
+ *
+ * Needs GLSL 1.20 with instanced arrays (GL 3.3, or ARB_instanced_arrays and
+ * ARB_draw_instanced), and draws with its own program.
+ */
+class CapsImpostors {
+private:
+	struct Instance {
+		float end0[4];	// w: radius
+		float end1[3];
+		unsigned char color[4];
+	};
+	std::vector<Instance> inst;
+	bool inst_dirty;
+
+	int gl_status;	// 0 not set up yet, 1 ready, -1 not supported
+	unsigned int prog;
+	int lighting_loc;
+	unsigned int box_vbo, box_ibo, inst_vbo;
+	int inst_vbo_size;
+
+	void upload();
+
+public:
+	CapsImpostors();
+	~CapsImpostors();
+
+	void clear();
+	// world space ends and radius, and packed RGBA8 color
+	void add(const Vec3 &a, const Vec3 &b, float rad, unsigned int color);
+	int size() const;
+
+	/* sets up the program and buffers the first time. Returns false if
+	 * impostors aren't supported, in which case draw does nothing.
+	 */
+	bool init_gl();
+	void draw();
+};
+
+}	// namespace vrtk
+
+#endif	// CAPS_IMPOSTOR_H_
@@ -0,0 +1,112 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "frame_clock.h"
+#include "scene.h"
+#include "anim_store.h"
+#include "xform_store.h"
+#include "stats_priv.h"
+#include "input.h"
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+namespace vrtk {
+
+static long clock_msec();
+
+static long frame_time = -1;	// -1 until the host advances or sets the clock
+
+void advance_frame_clock()
+{
+	set_frame_time(clock_msec());
+}
+
+void set_frame_time(long msec)
+{
+	frame_time = msec;
+	stats_end_frame();
+	get_anim_store()->update(msec);
+}
+
+long get_frame_time()
+{
+	return frame_msec();
+}
+
+bool need_redraw(long *next_change)
+{
+	long now = frame_msec();
+	AnimStore *anims = get_anim_store();
+	if(frame_time < 0) {
+		anims->update(now);	// the host doesn't drive the clock, nothing else will
+	}
+
+	long next = anims->next_change(now);
+	if(next_change) {
+		*next_change = next;
+	}
+	return next == now || get_xform_store()->is_dirty() || input_pending();
+}
+
+long frame_msec()
+{
+	// hosts which don't drive the clock get the time of each call
+	return frame_time >= 0 ? frame_time : clock_msec();
+}
+
+/* milliseconds since the first call, so that the start of the monotonic
+ * clock doesn't matter
+ */
+static long clock_msec()
+{
+	static long long start = -1;
+
+	long long usec = clock_usec();
+	if(start < 0) {
+		start = usec;
+	}
+	return (long)((usec - start) / 1000);
+}
+
+#ifdef WIN32
+long long clock_usec()
+{
+	static LARGE_INTEGER freq;
+	if(!freq.QuadPart) {
+		QueryPerformanceFrequency(&freq);
+	}
+	LARGE_INTEGER cnt;
+	QueryPerformanceCounter(&cnt);
+	// split, so that neither the product overflows, nor precision is lost
+	long long sec = cnt.QuadPart / freq.QuadPart;
+	long long rem = cnt.QuadPart % freq.QuadPart;
+	return sec * 1000000 + rem * 1000000 / freq.QuadPart;
+}
+#else
+long long clock_usec()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+#endif
+
+}	// namespace vrtk
@@ -0,0 +1,33 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef FRAME_CLOCK_H_
+#define FRAME_CLOCK_H_
+
+namespace vrtk {
+
+/* monotonic time in microseconds, from an arbitrary starting point */
+long long clock_usec();
+
+/* the current frame time in milliseconds (see advance_frame_clock in
+ * scene.h). The default time source of all BoolAnims.
+ */
+long frame_msec();
+
+}	// namespace vrtk
+
+#endif	// FRAME_CLOCK_H_
@@ -55,6 +55,82 @@ AABox::AABox(const Vec3 &min, const Vec3 &max)
 {
 }
 
+/* Arvo's method: accumulate the min/max contribution of each matrix element
+ * instead of transforming all 8 corners.
+ */
+void AABox::transform(const Mat4 &xform)
+{
+	Vec3 nmin, nmax;
+	for(int i=0; i<3; i++) {
+		nmin[i] = nmax[i] = xform[3][i];
+
+		for(int j=0; j<3; j++) {
+			float a = xform[j][i] * min[j];
+			float b = xform[j][i] * max[j];
+			if(a < b) {
+				nmin[i] += a;
+				nmax[i] += b;
+			} else {
+				nmin[i] += b;
+				nmax[i] += a;
+			}
+		}
+	}
+	min = nmin;
+	max = nmax;
+}
+
+Frustum::Frustum()
+{
+	// unit cube in clip space
+	set_viewproj(Mat4::identity);
+}
+
+Frustum::Frustum(const Mat4 &viewproj)
+{
+	set_viewproj(viewproj);
+}
+
+static inline Vec4 mat_row(const Mat4 &m, int row)
+{
+	return Vec4(m[0][row], m[1][row], m[2][row], m[3][row]);
+}
+
+static inline Vec4 norm_plane(const Vec4 &p)
+{
+	float len = sqrt(p.x * p.x + p.y * p.y + p.z * p.z);
+	return len == 0.0f ? p : Vec4(p.x / len, p.y / len, p.z / len, p.w / len);
+}
+
+/* Gribb & Hartmann plane extraction from the combined view-projection matrix */
+void Frustum::set_viewproj(const Mat4 &viewproj)
+{
+	Vec4 rx = mat_row(viewproj, 0);
+	Vec4 ry = mat_row(viewproj, 1);
+	Vec4 rz = mat_row(viewproj, 2);
+	Vec4 rw = mat_row(viewproj, 3);
+
+	plane[FRUSTUM_LEFT] = norm_plane(rw + rx);
+	plane[FRUSTUM_RIGHT] = norm_plane(rw - rx);
+	plane[FRUSTUM_BOTTOM] = norm_plane(rw + ry);
+	plane[FRUSTUM_TOP] = norm_plane(rw - ry);
+	plane[FRUSTUM_NEAR] = norm_plane(rw + rz);
+	plane[FRUSTUM_FAR] = norm_plane(rw - rz);
+}
+
+/* The eyes of an HMD are offset along their common horizontal axis, which
+ * lies in the top/bottom/near/far planes of both frusta, so those planes are
+ * shared. Taking the left plane of the left eye and the right plane of the
+ * right eye gives a frustum enclosing both.
+ */
+void Frustum::set_stereo(const Mat4 &left_viewproj, const Mat4 &right_viewproj)
+{
+	set_viewproj(left_viewproj);
+
+	Frustum rfrust(right_viewproj);
+	plane[FRUSTUM_RIGHT] = rfrust.plane[FRUSTUM_RIGHT];
+}
+
 #define EPSILON	1e-5f
 
 bool intersect(const Ray &ray, const Sphere &sph, HitPoint *hit)
@@ -109,66 +185,52 @@ bool intersect(const Sphere &s1, const Sphere &s2, HitPoint *hit)
 	return true;
 }
 
+/* intersects the ray with the infinite cylinder around the axis, using the
+ * components of the ray perpendicular to it, and keeps the nearest hit
+ * between the two ends.
+ */
 bool intersect(const Ray &ray, const Cylinder &cyl, HitPoint *hit)
 {
-	/* construct an orthonormal basis, to transform ray to a cylinder-friendly
-	 * coordinate system (cylinder axis aligned with the Y axis).
-	 */
-	Vec3 vj = normalize(cyl.end[1] - cyl.end[0]);
-	Vec3 vk = Vec3(0, 0, 1);
-	if(fabs(dot(vj, vk)) < 1e-3) {
-		vk = Vec3(1, 0, 0);
-	}
-	Vec3 vi = normalize(cross(vj, vk));
-	vk = cross(vi, vj);
-
-	Mat4 xform = Mat4(vi, vj, vk);
-	Mat4 inv_xform = transpose(xform);
-
-	Ray lray = inv_xform * ray;
-
-	float a = lray.dir.x * lray.dir.x + lray.dir.z * lray.dir.z;
-	float b = 2.0 * lray.dir.x * lray.origin.x + 2.0 * lray.dir.z * lray.origin.z;
-	float c = lray.origin.x * lray.origin.x + lray.origin.z * lray.origin.z - cyl.rad * cyl.rad;
-	float d = b * b - 4.0 * a * c;
-
-	if(d < 0.0) {
+	Vec3 axis = cyl.end[1] - cyl.end[0];
+	float len = length(axis);
+	if(len < EPSILON) {
 		return false;
 	}
-	float sqrt_d = sqrt(d);
-	float t1 = (-b + sqrt_d) / (2.0 * a);
-	float t2 = (-b + sqrt_d) / (2.0 * a);
+	axis /= len;
 
-	if(t1 < EPSILON && t2 < EPSILON) {
-		return false;
-	}
-
-	Vec3 p1 = lray.origin + lray.dir * t1;
-	Vec3 p2 = lray.origin + lray.dir * t2;
+	Vec3 oc = ray.origin - cyl.end[0];
+	Vec3 dir_perp = ray.dir - axis * dot(ray.dir, axis);
+	Vec3 oc_perp = oc - axis * dot(oc, axis);
 
-	unsigned int valid = 3;
-	if(t1 < EPSILON || p1.y < cyl.end[0].y || p1.y >= cyl.end[1].y) {
-		valid &= ~1;
-		t1 = t2;
-	}
-	if(t2 < EPSILON || p2.y < cyl.end[0].y || p2.y >= cyl.end[1].y) {
-		valid &= ~2;
-		t2 = t1;
+	float a = dot(dir_perp, dir_perp);
+	if(a < EPSILON) {
+		return false;	// parallel to the axis, never hits the side
 	}
+	float b = 2.0f * dot(dir_perp, oc_perp);
+	float c = dot(oc_perp, oc_perp) - cyl.rad * cyl.rad;
+	float d = b * b - 4.0f * a * c;
 
-	if(!valid) {
+	if(d < 0.0f) {
 		return false;
 	}
+	float sqrt_d = sqrt(d);
+	float t[2] = {(-b - sqrt_d) / (2.0f * a), (-b + sqrt_d) / (2.0f * a)};
 
-	if(hit) {
-		hit->t = t1 < t2 ? t1 : t2;
+	for(int i=0; i<2; i++) {
+		if(t[i] < EPSILON) continue;
 
-		hit->pos = ray.origin + ray.dir * hit->t;
-		hit->norm = Vec3(1.0, 0.0, 1.0) * hit->pos / cyl.rad;
+		Vec3 pos = oc + ray.dir * t[i];
+		float y = dot(pos, axis);
+		if(y < 0.0f || y > len) continue;
 
-		hit->norm = xform.upper3x3() * hit->norm;
+		if(hit) {
+			hit->t = t[i];
+			hit->pos = ray.origin + ray.dir * t[i];
+			hit->norm = normalize(pos - axis * y);
+		}
+		return true;
 	}
-	return true;
+	return false;
 }
 
 bool intersect(const Ray &ray, const AABox &box, HitPoint *hit)
@@ -236,10 +298,31 @@ bool intersect(const Ray &ray, const AABox &box, HitPoint *hit)
 
 }
 
+/* conservative test: only rejects boxes entirely outside one of the planes */
+bool intersect(const Frustum &frust, const AABox &box)
+{
+	for(int i=0; i<6; i++) {
+		const Vec4 &p = frust.plane[i];
+
+		// test the box corner furthest along the plane normal
+		Vec3 v;
+		v.x = p.x >= 0.0f ? box.max.x : box.min.x;
+		v.y = p.y >= 0.0f ? box.max.y : box.min.y;
+		v.z = p.z >= 0.0f ? box.max.z : box.min.z;
+
+		if(p.x * v.x + p.y * v.y + p.z * v.z + p.w < 0.0f) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// parameter of the projection of the point on the line, origin + dir * t
 float proj_point_line_param(const Vec3 &pt, const Ray &ray)
 {
-	Vec3 pdir = normalize(pt - ray.origin);
-	return dot(pdir, ray.dir);
+	float lensq = dot(ray.dir, ray.dir);
+	if(lensq < EPSILON) return 0.0f;	// degenerate line, all of it is the origin
+	return dot(pt - ray.origin, ray.dir) / lensq;
 }
 
 }	// namespace vrtk
@@ -53,12 +53,40 @@ public:
 
 	AABox();
 	AABox(const Vec3 &min, const Vec3 &max);
+
+	/* transforms the box and replaces it with the axis-aligned box enclosing
+	 * the result
+	 */
+	void transform(const Mat4 &xform);
+};
+
+/* view frustum as 6 planes (a, b, c, d) with normals pointing inwards */
+enum {
+	FRUSTUM_LEFT,
+	FRUSTUM_RIGHT,
+	FRUSTUM_BOTTOM,
+	FRUSTUM_TOP,
+	FRUSTUM_NEAR,
+	FRUSTUM_FAR
+};
+
+class Frustum {
+public:
+	Vec4 plane[6];
+
+	Frustum();
+	Frustum(const Mat4 &viewproj);
+
+	void set_viewproj(const Mat4 &viewproj);
+	/* single conservative frustum enclosing both eyes of a stereo pair */
+	void set_stereo(const Mat4 &left_viewproj, const Mat4 &right_viewproj);
 };
 
 bool intersect(const Ray &ray, const Sphere &sph, HitPoint *hit = 0);
 bool intersect(const Sphere &s1, const Sphere &s2, HitPoint *hit = 0);
 bool intersect(const Ray &ray, const Cylinder &cyl, HitPoint *hit = 0);
 bool intersect(const Ray &ray, const AABox &box, HitPoint *hit = 0);
+bool intersect(const Frustum &frust, const AABox &box);
 
 float proj_point_line_param(const Vec3 &pt, const Ray &ray);
 
@@ -0,0 +1,327 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <mutex>
+#include "opengl.h"
+#include "glstate.h"
+#include "render.h"
+
+namespace vrtk {
+
+#define UNKNOWN		0xffffffff
+
+static unsigned int cur_prog;
+static bool prog_known;
+static bool host_sets_prog;
+
+static unsigned int cur_vbo = UNKNOWN;
+static unsigned int cur_ibo = UNKNOWN;
+
+/* enabled arrays, and which of the bits are known to match the GL state.
+ * Everything starts out disabled, as in a fresh context.
+ */
+static unsigned int client_mask, client_known = 0xf;
+static unsigned int attrib_mask, attrib_known = 0xffffffff;
+
+static unsigned int cur_vao;
+
+// per-VAO part of the state, kept for VAO 0 while another one is bound
+struct ArrayState {
+	unsigned int ibo;
+	unsigned int client_mask, client_known;
+	unsigned int attrib_mask, attrib_known;
+};
+static ArrayState vao0_state;
+
+static void save_array_state(ArrayState *st)
+{
+	st->ibo = cur_ibo;
+	st->client_mask = client_mask;
+	st->client_known = client_known;
+	st->attrib_mask = attrib_mask;
+	st->attrib_known = attrib_known;
+}
+
+static void restore_array_state(const ArrayState *st)
+{
+	cur_ibo = st->ibo;
+	client_mask = st->client_mask;
+	client_known = st->client_known;
+	attrib_mask = st->attrib_mask;
+	attrib_known = st->attrib_known;
+}
+
+unsigned int gl_current_program()
+{
+	if(!prog_known) {
+		int prog = 0;
+		glGetIntegerv(GL_CURRENT_PROGRAM, &prog);
+		cur_prog = prog;
+		prog_known = true;
+	}
+	return cur_prog;
+}
+
+void gl_use_program(unsigned int prog)
+{
+	if(prog_known && prog == cur_prog) {
+		return;
+	}
+	glUseProgram(prog);
+	cur_prog = prog;
+	prog_known = true;
+}
+
+void gl_bind_buffer(unsigned int target, unsigned int buf)
+{
+	unsigned int *cur = target == GL_ELEMENT_ARRAY_BUFFER ? &cur_ibo : &cur_vbo;
+	if(*cur != buf) {
+		glBindBuffer(target, buf);
+		*cur = buf;
+	}
+}
+
+// objects waiting to be deleted on the GL thread
+static std::vector<unsigned int> dead_bufs, dead_vaos;
+static std::vector<unsigned int> dead_texs, dead_fbos, dead_rbufs, dead_progs;
+static std::mutex dead_mutex;
+
+void gl_delete_buffers(int count, const unsigned int *bufs)
+{
+	std::lock_guard<std::mutex> lock(dead_mutex);
+	dead_bufs.insert(dead_bufs.end(), bufs, bufs + count);
+}
+
+void gl_delete_textures(int count, const unsigned int *texs)
+{
+	std::lock_guard<std::mutex> lock(dead_mutex);
+	dead_texs.insert(dead_texs.end(), texs, texs + count);
+}
+
+void gl_delete_framebuffers(int count, const unsigned int *fbos)
+{
+	std::lock_guard<std::mutex> lock(dead_mutex);
+	dead_fbos.insert(dead_fbos.end(), fbos, fbos + count);
+}
+
+void gl_delete_renderbuffers(int count, const unsigned int *rbufs)
+{
+	std::lock_guard<std::mutex> lock(dead_mutex);
+	dead_rbufs.insert(dead_rbufs.end(), rbufs, rbufs + count);
+}
+
+void gl_delete_program(unsigned int prog)
+{
+	std::lock_guard<std::mutex> lock(dead_mutex);
+	dead_progs.push_back(prog);
+}
+
+#ifndef GL_ES_VERSION_2_0
+static const unsigned int client_arrays[] = {
+	GL_VERTEX_ARRAY, GL_NORMAL_ARRAY, GL_TEXTURE_COORD_ARRAY, GL_COLOR_ARRAY
+};
+#endif
+
+void gl_set_client_arrays(unsigned int mask)
+{
+#ifndef GL_ES_VERSION_2_0
+	unsigned int diff = ((mask ^ client_mask) | ~client_known) & 0xf;
+
+	for(int i=0; diff; i++) {
+		unsigned int bit = 1 << i;
+		if(diff & bit) {
+			if(mask & bit) {
+				glEnableClientState(client_arrays[i]);
+			} else {
+				glDisableClientState(client_arrays[i]);
+			}
+			diff &= ~bit;
+		}
+	}
+	client_mask = mask;
+	client_known = 0xf;
+#endif
+}
+
+void gl_set_attrib_arrays(unsigned int mask)
+{
+	unsigned int diff = (mask ^ attrib_mask) | ~attrib_known;
+
+	for(int i=0; diff; i++) {
+		unsigned int bit = 1 << i;
+		if(diff & bit) {
+			if(mask & bit) {
+				glEnableVertexAttribArray(i);
+			} else {
+				glDisableVertexAttribArray(i);
+			}
+			diff &= ~bit;
+		}
+	}
+	attrib_mask = mask;
+	attrib_known = 0xffffffff;
+}
+
+bool gl_have_vao()
+{
+#ifdef GL_ES_VERSION_2_0
+	return false;
+#else
+	static int have_vao = -1;
+
+	if(have_vao == -1) {
+		const char *ver = (const char*)glGetString(GL_VERSION);
+		const char *ext = (const char*)glGetString(GL_EXTENSIONS);
+
+		have_vao = (ver && atoi(ver) >= 3) || (ext && strstr(ext, "GL_ARB_vertex_array_object"));
+	}
+	return have_vao;
+#endif
+}
+
+void gl_bind_vertex_array(unsigned int vao, bool new_vao)
+{
+#ifndef GL_ES_VERSION_2_0
+	if((vao == cur_vao && !new_vao) || !gl_have_vao()) {
+		return;
+	}
+	glBindVertexArray(vao);
+
+	if(cur_vao == 0) {
+		save_array_state(&vao0_state);
+	}
+
+	if(!vao) {
+		restore_array_state(&vao0_state);
+	} else if(new_vao) {
+		cur_ibo = 0;
+		client_mask = attrib_mask = 0;
+		client_known = 0xf;
+		attrib_known = 0xffffffff;
+	} else {
+		cur_ibo = UNKNOWN;
+		client_known = attrib_known = 0;
+	}
+	cur_vao = vao;
+#endif
+}
+
+void gl_delete_vertex_array(unsigned int vao)
+{
+	std::lock_guard<std::mutex> lock(dead_mutex);
+	dead_vaos.push_back(vao);
+}
+
+static void delete_dead_objects()
+{
+	std::lock_guard<std::mutex> lock(dead_mutex);
+
+	int num = dead_bufs.size();
+	for(int i=0; i<num; i++) {
+		// a deleted buffer is unbound, and its name may be reused
+		unsigned int buf = dead_bufs[i];
+		if(buf == cur_vbo) cur_vbo = 0;
+		if(buf == cur_ibo) cur_ibo = 0;
+		// only unbound from the current VAO, the name may still be in VAO 0
+		if(buf == vao0_state.ibo) vao0_state.ibo = UNKNOWN;
+	}
+	if(num) {
+		glDeleteBuffers(num, &dead_bufs[0]);
+		dead_bufs.clear();
+	}
+
+#ifndef GL_ES_VERSION_2_0
+	num = dead_vaos.size();
+	for(int i=0; i<num; i++) {
+		if(dead_vaos[i] == cur_vao) {
+			// deleting the bound VAO reverts to VAO 0
+			restore_array_state(&vao0_state);
+			cur_vao = 0;
+		}
+	}
+	if(num) {
+		glDeleteVertexArrays(num, &dead_vaos[0]);
+		dead_vaos.clear();
+	}
+#endif
+
+	// none of these are left bound by vrtk, nothing to fix up
+	if(!dead_texs.empty()) {
+		glDeleteTextures(dead_texs.size(), &dead_texs[0]);
+		dead_texs.clear();
+	}
+	if(!dead_fbos.empty()) {
+		glDeleteFramebuffers(dead_fbos.size(), &dead_fbos[0]);
+		dead_fbos.clear();
+	}
+	if(!dead_rbufs.empty()) {
+		glDeleteRenderbuffers(dead_rbufs.size(), &dead_rbufs[0]);
+		dead_rbufs.clear();
+	}
+	// GL keeps a program alive while it's current, so that's fine too
+	for(size_t i=0; i<dead_progs.size(); i++) {
+		glDeleteProgram(dead_progs[i]);
+	}
+	dead_progs.clear();
+}
+
+void gl_reset_arrays()
+{
+	gl_bind_vertex_array(0);
+	gl_set_client_arrays(0);
+	gl_set_attrib_arrays(0);
+	gl_bind_buffer(GL_ARRAY_BUFFER, 0);
+	gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void gl_begin_frame()
+{
+	delete_dead_objects();
+
+	if(!host_sets_prog) {
+		prog_known = false;
+	}
+}
+
+void set_active_program(unsigned int prog)
+{
+	cur_prog = prog;
+	prog_known = true;
+	host_sets_prog = true;
+}
+
+unsigned int get_active_program()
+{
+	return gl_current_program();
+}
+
+void invalidate_gl_state()
+{
+	prog_known = false;
+	cur_vbo = cur_ibo = UNKNOWN;
+	client_known = 0;
+	// every GL implementation has at least 16 attribute locations
+	attrib_known = 0xffff0000;
+
+	cur_vao = UNKNOWN;
+	save_array_state(&vao0_state);
+}
+
+}	// namespace vrtk
@@ -0,0 +1,84 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef GLSTATE_H_
+#define GLSTATE_H_
+
+namespace vrtk {
+
+/* Shadow copy of the GL state vrtk changes while drawing: the current
+ * program, the buffer bindings and the enabled vertex arrays. Calls which
+ * wouldn't change anything are skipped, and the current program is only
+ * queried from GL when it's not known (see set_active_program in render.h).
+ *
+ * All GL state vrtk touches must go through these, or the shadow copy will
+ * be out of date.
+ */
+
+// fixed-function vertex arrays, for gl_set_client_arrays
+enum {
+	GLS_VERTEX_ARRAY	= 1,
+	GLS_NORMAL_ARRAY	= 2,
+	GLS_TEXCOORD_ARRAY	= 4,
+	GLS_COLOR_ARRAY		= 8
+};
+
+unsigned int gl_current_program();
+void gl_use_program(unsigned int prog);
+
+// target is GL_ARRAY_BUFFER or GL_ELEMENT_ARRAY_BUFFER
+void gl_bind_buffer(unsigned int target, unsigned int buf);
+/* deleting GL objects is deferred to the next gl_begin_frame, so that it's
+ * safe from any thread. Meshes and such can be created and destroyed while
+ * recording, away from the GL thread.
+ */
+void gl_delete_buffers(int count, const unsigned int *bufs);
+void gl_delete_textures(int count, const unsigned int *texs);
+void gl_delete_framebuffers(int count, const unsigned int *fbos);
+void gl_delete_renderbuffers(int count, const unsigned int *rbufs);
+void gl_delete_program(unsigned int prog);
+
+/* enable exactly the arrays in the mask, and disable the rest. Bit n of the
+ * attribute mask stands for generic vertex attribute location n.
+ */
+void gl_set_client_arrays(unsigned int mask);
+void gl_set_attrib_arrays(unsigned int mask);
+
+/* vertex array objects, where available (GL 3.0 or ARB_vertex_array_object).
+ * A VAO has its own element buffer binding and enabled arrays: the shadow of
+ * those for VAO 0 is set aside while another one is bound, and restored when
+ * going back to 0. Pass new_vao when binding a freshly created one, to let
+ * the shadow copy know everything is disabled in it.
+ */
+bool gl_have_vao();
+void gl_bind_vertex_array(unsigned int vao, bool new_vao = false);
+void gl_delete_vertex_array(unsigned int vao);
+
+/* go back to VAO 0, unbind buffers and disable all vertex arrays, which is
+ * the state vrtk leaves GL in after drawing
+ */
+void gl_reset_arrays();
+
+/* called on the GL thread at the start of every frame. Deletes the objects
+ * queued for deletion, and forgets the current program, unless the host
+ * keeps vrtk informed through set_active_program.
+ */
+void gl_begin_frame();
+
+}	// namespace vrtk
+
+#endif	// GLSTATE_H_
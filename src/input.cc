@@ -15,59 +15,771 @@ GNU Lesser General Public License for more details.
 You should have received a copy of the GNU Lesser General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
+#include <math.h>
+#include <float.h>
+#include <vector>
+#include <algorithm>
 #include "input.h"
 #include "widget.h"
+#include "widgetgroup.h"
+#include "geom.h"
+#include "input_queue.h"
+#include "pose_predict.h"
+#include "input_log.h"
+#include "trace_priv.h"
 
 namespace vrtk {
 
-static enum PtrMode { PTR_RAY, PTR_3D } ptr_mode;
-static Ray ptr_ray;
-static Vec3 ptr_pos;
-static Quat ptr_rot;
+enum PtrMode { PTR_RAY, PTR_3D };
 
-static Widget *kbfocus;
+struct Pointer {
+	bool used;
+	PtrMode mode;
+	Ray ray;
+	Vec3 pos;
+	Quat rot;
+	bool moved;		// pose changed since the last pick
+
+	// pose picked with: predicted for the display time, or the same as above
+	Ray pick_ray;
+	Vec3 pick_pos;
+	Quat pick_rot;
+
+	bool predict;
+	PosePredictor pred;
+
+	unsigned int buttons;	// one bit per pressed button
+
+	/* handles instead of pointers, so that widgets destroyed while hovered
+	 * or grabbed are simply forgotten
+	 */
+	WidgetHandle hover;
+	bool hovering;
+
+	WidgetHandle grab;
+	bool grabbing, dragging;
+	int grab_bn;
+	float grab_dist;	// along the ray, for ray pointers
+	Vec3 grab_start;
+
+	Pointer();
+};
+
+Pointer::Pointer()
+{
+	used = false;
+	mode = PTR_RAY;
+	moved = false;
+	predict = false;
+	buttons = 0;
+	hovering = grabbing = dragging = false;
+	grab_bn = 0;
+	grab_dist = 0.0f;
+}
+
+static std::vector<WidgetGroup*> groups;
+
+// pointer ids are indices, and slots of removed pointers get reused
+static std::vector<Pointer> pointers;
+
+/* scratch space for batched picking, sized when pointers are added, so that
+ * picking never allocates
+ */
+static std::vector<Ray> pick_rays;
+static std::vector<Vec3> pick_pts;
+static std::vector<HitPoint> pick_hits, pick_nearest;
+static std::vector<Widget*> pick_found, pick_contained;
+static std::vector<int> pick_ray_ptr, pick_pt_ptr;
+
+static InputQueue queue;
+static long long event_time;
+static long long display_time;
+
+static InputLogWriter *recorder;
+
+static float drag_thres = 0.01f;
+
+// a handle, so that deleting the focused widget doesn't leave it dangling
+static WidgetHandle kbfocus;
+static bool has_kbfocus;
+
+static void set_hover(Pointer *ptr, Widget *w);
+static void release(Pointer *ptr, bool activate);
+static void record(int type, int ptr);
+
+static int new_pointer()
+{
+	int id = 0;
+	while(id < (int)pointers.size() && pointers[id].used) {
+		id++;
+	}
+	if(id == (int)pointers.size()) {
+		pointers.push_back(Pointer());
+
+		int num = pointers.size();
+		pick_rays.resize(num);
+		pick_pts.resize(num);
+		pick_hits.resize(num);
+		pick_nearest.resize(num);
+		pick_found.resize(num);
+		pick_contained.resize(num);
+		pick_ray_ptr.resize(num);
+		pick_pt_ptr.resize(num);
+	}
+	pointers[id] = Pointer();
+	pointers[id].used = true;
+	return id;
+}
+
+// pointer 0 always exists, for hosts which only have one
+static inline void init_pointers()
+{
+	if(pointers.empty()) {
+		new_pointer();
+	}
+}
+
+static Pointer *get_pointer(int id)
+{
+	init_pointers();
+	if(id < 0 || id >= (int)pointers.size() || !pointers[id].used) {
+		return 0;
+	}
+	return &pointers[id];
+}
+
+int input_add_pointer()
+{
+	init_pointers();
+	int id = new_pointer();
+	record(ILOG_ADD_POINTER, id);
+	return id;
+}
+
+void input_remove_pointer(int id)
+{
+	Pointer *ptr = get_pointer(id);
+	if(!ptr || id == 0) return;
+	record(ILOG_REMOVE_POINTER, id);
+
+	if(ptr->grabbing) {
+		release(ptr, false);
+	}
+	set_hover(ptr, 0);
+	ptr->used = false;
+}
+
+void input_add_group(WidgetGroup *g)
+{
+	if(std::find(groups.begin(), groups.end(), g) == groups.end()) {
+		groups.push_back(g);
+	}
+}
+
+void input_remove_group(WidgetGroup *g)
+{
+	std::vector<WidgetGroup*>::iterator it = std::find(groups.begin(), groups.end(), g);
+	if(it != groups.end()) {
+		groups.erase(it);
+	}
+}
+
+void set_drag_threshold(float dist)
+{
+	drag_thres = dist;
+}
+
+float get_drag_threshold()
+{
+	return drag_thres;
+}
 
 void set_keyboard_focus(Widget *w)
 {
-	if(kbfocus) {
-		kbfocus->on_input_focus(false);
+	Widget *prev = get_keyboard_focus();
+	if(prev) {
+		prev->on_input_focus(false);
+	}
+	has_kbfocus = w != 0;
+	if(w) {
+		kbfocus = w->get_handle();
+		w->on_input_focus(true);
 	}
-	kbfocus = w;
-	w->on_input_focus(true);
+}
+
+Widget *get_keyboard_focus()
+{
+	return has_kbfocus ? Widget::from_handle(kbfocus) : 0;
 }
 
 void input_keyboard(int key, bool pressed)
 {
-	if(kbfocus) {
+	TRACE_ZONE("input_keyboard");
+
+	if(recorder) {
+		InputRecord rec;
+		rec.type = ILOG_KEYBOARD;
+		rec.code = key;
+		rec.pressed = pressed;
+		recorder->write(&rec);
+	}
+
+	Widget *w = get_keyboard_focus();
+	if(w) {
 		if(pressed) {
-			kbfocus->on_key_press(key);
+			w->on_key_press(key);
 		} else {
-			kbfocus->on_key_release(key);
+			w->on_key_release(key);
 		}
 	}
 }
 
-void input_ray_pointer(const Vec3 &origin, const Vec3 &dir)
+// rotation of the -Z axis onto the direction of a ray pointer
+static Quat ray_rotation(const Vec3 &dir)
 {
-	ptr_mode = PTR_RAY;
-	ptr_ray.origin = origin;
-	ptr_ray.dir = dir;
+	Vec3 ndir = normalize(dir);
+	Vec3 axis = cross(Vec3(0, 0, -1), ndir);
+	float len = length(axis);
+	if(len < 1e-6f) {
+		return ndir.z <= 0.0f ? Quat::identity : Quat(Vec3(0, 1, 0), M_PI);
+	}
+	float cos_angle = std::max(-1.0f, std::min(-ndir.z, 1.0f));
+	return Quat(axis / len, acos(cos_angle));
+}
 
-	// TODO test widgets and generate events
+static void pointer_pose(const Pointer *ptr, Vec3 *pos, Quat *rot)
+{
+	if(ptr->mode == PTR_RAY) {
+		*pos = ptr->pick_ray.origin + ptr->pick_ray.dir * ptr->grab_dist;
+		*rot = ray_rotation(ptr->pick_ray.dir);
+	} else {
+		*pos = ptr->pick_pos;
+		*rot = ptr->pick_rot;
+	}
+}
+
+static void update_pick_pose(Pointer *ptr)
+{
+	ptr->pick_ray = ptr->ray;
+	ptr->pick_pos = ptr->pos;
+	ptr->pick_rot = ptr->rot;
+
+	if(ptr->predict && display_time) {
+		Vec3 dir;
+		Quat rot;
+		if(ptr->mode == PTR_RAY) {
+			ptr->pred.predict(display_time, &ptr->pick_ray.origin, &ptr->pick_ray.dir, &rot);
+		} else {
+			ptr->pred.predict(display_time, &ptr->pick_pos, &dir, &ptr->pick_rot);
+		}
+	}
+}
+
+static Widget *hovered_widget(const Pointer *ptr)
+{
+	return ptr->hovering ? Widget::from_handle(ptr->hover) : 0;
+}
+
+/* a widget is hovered while any pointer is over it: it gets a hover event
+ * when the first pointer enters it, and when the last one leaves
+ */
+static bool hovered_by_other(const Pointer *ptr, const Widget *w)
+{
+	int num = pointers.size();
+	for(int i=0; i<num; i++) {
+		const Pointer *p = &pointers[i];
+		if(p != ptr && p->used && hovered_widget(p) == w) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void set_hover(Pointer *ptr, Widget *w)
+{
+	Widget *prev = hovered_widget(ptr);
+	if(w == prev) return;
+
+	ptr->hovering = w != 0;
+	if(w) {
+		ptr->hover = w->get_handle();
+	}
+
+	if(prev && !hovered_by_other(ptr, prev)) {
+		prev->on_hover(false);
+	}
+	if(w && !hovered_by_other(ptr, w)) {
+		w->on_hover(true);
+	}
+}
+
+static bool grabbed_by_other(const Pointer *ptr, const Widget *w)
+{
+	int num = pointers.size();
+	for(int i=0; i<num; i++) {
+		const Pointer *p = &pointers[i];
+		if(p != ptr && p->used && p->grabbing && Widget::from_handle(p->grab) == w) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// returns false if the grabbed widget is gone, and the pointer should pick
+static bool drag(Pointer *ptr)
+{
+	Widget *w = Widget::from_handle(ptr->grab);
+	if(!w) {
+		ptr->grabbing = false;
+		return false;
+	}
+
+	Vec3 pos;
+	Quat rot;
+	pointer_pose(ptr, &pos, &rot);
+
+	if(!ptr->dragging && distance_sq(pos, ptr->grab_start) > drag_thres * drag_thres) {
+		ptr->dragging = true;
+	}
+	if(ptr->dragging) {
+		w->on_drag(pos, rot);
+	}
+	return true;
+}
+
+void input_ray_pointer(const Vec3 &origin, const Vec3 &dir)
+{
+	input_ray_pointer(0, origin, dir);
 }
 
 void input_3d_pointer(const Vec3 &pos, const Quat &rot)
 {
-	ptr_mode = PTR_3D;
-	ptr_pos = pos;
-	ptr_rot = rot;
+	input_3d_pointer(0, pos, rot);
+}
+
+void input_ray_pointer(int id, const Vec3 &origin, const Vec3 &dir)
+{
+	input_set_ray_pointer(id, origin, dir);
+	input_process_pointers();
+}
+
+void input_3d_pointer(int id, const Vec3 &pos, const Quat &rot)
+{
+	input_set_3d_pointer(id, pos, rot);
+	input_process_pointers();
+}
+
+// untimed poses, and switching modes, start the prediction history over
+void input_set_ray_pointer(int id, const Vec3 &origin, const Vec3 &dir, long long usec)
+{
+	Pointer *ptr = get_pointer(id);
+	if(!ptr) return;
+
+	if(!usec || ptr->mode != PTR_RAY) {
+		ptr->pred.reset();
+	}
+	if(usec) {
+		ptr->pred.add_sample(usec, origin, dir, Quat::identity);
+	}
+	if(recorder) {
+		InputRecord rec;
+		rec.type = ILOG_RAY_POINTER;
+		rec.ptr = id;
+		rec.usec = usec;
+		rec.pos = origin;
+		rec.dir = dir;
+		recorder->write(&rec);
+	}
+
+	ptr->mode = PTR_RAY;
+	ptr->ray.origin = origin;
+	ptr->ray.dir = dir;
+	ptr->moved = true;
+}
+
+void input_set_3d_pointer(int id, const Vec3 &pos, const Quat &rot, long long usec)
+{
+	Pointer *ptr = get_pointer(id);
+	if(!ptr) return;
+
+	if(!usec || ptr->mode != PTR_3D) {
+		ptr->pred.reset();
+	}
+	if(usec) {
+		ptr->pred.add_sample(usec, pos, Vec3(0, 0, -1), rot);
+	}
+	if(recorder) {
+		InputRecord rec;
+		rec.type = ILOG_3D_POINTER;
+		rec.ptr = id;
+		rec.usec = usec;
+		rec.pos = pos;
+		rec.rot = rot;
+		recorder->write(&rec);
+	}
+
+	ptr->mode = PTR_3D;
+	ptr->pos = pos;
+	ptr->rot = rot;
+	ptr->moved = true;
+}
+
+void input_set_display_time(long long usec)
+{
+	display_time = usec;
+	if(recorder) {
+		InputRecord rec;
+		rec.type = ILOG_DISPLAY_TIME;
+		rec.usec = usec;
+		recorder->write(&rec);
+	}
+
+	// predicted poses change with it
+	int num = pointers.size();
+	for(int i=0; i<num; i++) {
+		if(pointers[i].used && pointers[i].predict) {
+			pointers[i].moved = true;
+		}
+	}
+}
+
+long long input_get_display_time()
+{
+	return display_time;
+}
+
+void input_set_prediction(int id, bool enable)
+{
+	Pointer *ptr = get_pointer(id);
+	if(ptr) {
+		ptr->predict = enable;
+		ptr->moved = true;
+	}
+}
+
+bool input_get_prediction(int id)
+{
+	Pointer *ptr = get_pointer(id);
+	return ptr && ptr->predict;
+}
+
+void input_set_prediction_horizon(int id, long usec)
+{
+	Pointer *ptr = get_pointer(id);
+	if(ptr) {
+		ptr->pred.set_horizon(usec);
+	}
+}
 
-	// TODO test widgets and generate events
+void input_set_prediction_smoothing(int id, float s)
+{
+	Pointer *ptr = get_pointer(id);
+	if(ptr) {
+		ptr->pred.set_smoothing(s);
+	}
+}
+
+/* grabbing pointers drag, and the rest are gathered for one batched pick per
+ * group: rays and points separately
+ */
+void input_process_pointers()
+{
+	TRACE_ZONE("input_process_pointers");
+
+	int num_rays = 0, num_pts = 0;
+
+	record(ILOG_PROCESS, 0);
+
+	int num = pointers.size();
+	for(int i=0; i<num; i++) {
+		Pointer *ptr = &pointers[i];
+		if(!ptr->used || !ptr->moved) continue;
+		ptr->moved = false;
+		update_pick_pose(ptr);
+
+		if(ptr->grabbing && drag(ptr)) {
+			continue;	// hover stays with the grabbed widget
+		}
+
+		if(ptr->mode == PTR_RAY) {
+			pick_rays[num_rays] = ptr->pick_ray;
+			pick_nearest[num_rays].obj = 0;
+			pick_nearest[num_rays].t = FLT_MAX;
+			pick_ray_ptr[num_rays++] = i;
+		} else {
+			pick_pts[num_pts] = ptr->pick_pos;
+			pick_found[num_pts] = 0;
+			pick_pt_ptr[num_pts++] = i;
+		}
+	}
+	if(!num_rays && !num_pts) return;
+
+	int num_groups = groups.size();
+	for(int i=0; i<num_groups; i++) {
+		if(num_rays) {
+			groups[i]->intersect(num_rays, &pick_rays[0], &pick_hits[0]);
+			for(int j=0; j<num_rays; j++) {
+				if(pick_hits[j].obj && pick_hits[j].t < pick_nearest[j].t) {
+					pick_nearest[j] = pick_hits[j];
+				}
+			}
+		}
+		if(num_pts) {
+			// the first group containing a point takes it
+			groups[i]->contains(num_pts, &pick_pts[0], &pick_contained[0]);
+			for(int j=0; j<num_pts; j++) {
+				if(!pick_found[j]) {
+					pick_found[j] = pick_contained[j];
+				}
+			}
+		}
+	}
+
+	for(int i=0; i<num_rays; i++) {
+		Pointer *ptr = &pointers[pick_ray_ptr[i]];
+		set_hover(ptr, (Widget*)pick_nearest[i].obj);
+		ptr->grab_dist = pick_nearest[i].t;
+	}
+	for(int i=0; i<num_pts; i++) {
+		Pointer *ptr = &pointers[pick_pt_ptr[i]];
+		set_hover(ptr, pick_found[i]);
+		ptr->grab_dist = 0.0f;
+	}
+}
+
+static void release(Pointer *ptr, bool activate)
+{
+	ptr->grabbing = false;
+
+	Widget *w = Widget::from_handle(ptr->grab);
+	if(!w) return;
+
+	Vec3 pos;
+	Quat rot;
+	pointer_pose(ptr, &pos, &rot);
+	w->on_release(pos, rot);
+	if(activate && !ptr->dragging) {
+		w->on_activate(pos, rot);
+	}
 }
 
 void input_button(int bn, bool pressed)
 {
-	// TODO generate events
+	input_button(0, bn, pressed);
+}
+
+/* any button grabs the hovered widget, unless another pointer holds it, and
+ * releasing the same button lets go of it. Releasing it before moving
+ * further than the drag threshold activates the widget.
+ */
+void input_button(int id, int bn, bool pressed)
+{
+	TRACE_ZONE("input_button");
+
+	Pointer *ptr = get_pointer(id);
+	if(!ptr) return;
+
+	if(recorder) {
+		InputRecord rec;
+		rec.type = ILOG_BUTTON;
+		rec.ptr = id;
+		rec.code = bn;
+		rec.pressed = pressed;
+		recorder->write(&rec);
+	}
+
+	unsigned int bit = 1u << (bn & 31);
+	if(pressed) {
+		ptr->buttons |= bit;
+	} else {
+		ptr->buttons &= ~bit;
+	}
+
+	if(pressed) {
+		if(ptr->grabbing) return;
+
+		Widget *w = hovered_widget(ptr);
+		if(!w || grabbed_by_other(ptr, w)) return;
+
+		Vec3 pos;
+		Quat rot;
+		pointer_pose(ptr, &pos, &rot);
+		ptr->grabbing = true;
+		ptr->dragging = false;
+		ptr->grab_bn = bn;
+		ptr->grab = w->get_handle();
+		ptr->grab_start = pos;
+		w->on_grab(pos, rot);
+
+	} else {
+		if(ptr->grabbing && bn == ptr->grab_bn) {
+			release(ptr, true);
+		}
+	}
+}
+
+bool input_button_state(int id, int bn)
+{
+	Pointer *ptr = get_pointer(id);
+	return ptr && (ptr->buttons & (1u << (bn & 31)));
+}
+
+static bool post(int type, int ptr, int code, bool pressed, const Vec3 &pos,
+		const Vec3 &dir, const Quat &rot, long long usec)
+{
+	InputEvent ev;
+	ev.type = type;
+	ev.ptr = ptr;
+	ev.code = code;
+	ev.pressed = pressed;
+	ev.time = usec;
+	ev.pos = pos;
+	ev.dir = dir;
+	ev.rot = rot;
+	return queue.push(ev);
+}
+
+bool input_post_keyboard(int key, bool pressed, long long usec)
+{
+	return post(IEV_KEYBOARD, 0, key, pressed, Vec3(), Vec3(), Quat(), usec);
+}
+
+bool input_post_ray_pointer(int ptr, const Vec3 &origin, const Vec3 &dir, long long usec)
+{
+	return post(IEV_RAY_POINTER, ptr, 0, false, origin, dir, Quat(), usec);
+}
+
+bool input_post_3d_pointer(int ptr, const Vec3 &pos, const Quat &rot, long long usec)
+{
+	return post(IEV_3D_POINTER, ptr, 0, false, pos, Vec3(), rot, usec);
+}
+
+bool input_post_button(int ptr, int bn, bool pressed, long long usec)
+{
+	return post(IEV_BUTTON, ptr, bn, pressed, Vec3(), Vec3(), Quat(), usec);
+}
+
+bool input_pending()
+{
+	if(queue.size() > 0) {
+		return true;
+	}
+
+	int num = pointers.size();
+	for(int i=0; i<num; i++) {
+		if(pointers[i].used && pointers[i].moved) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/* pointer motion only stores the new pose, so consecutive samples collapse
+ * into the last one. Moved pointers are picked for in one batch before the
+ * next button event, so that it happens where the pointer was at the time,
+ * and once more at the end.
+ */
+int input_drain_queue()
+{
+	TRACE_ZONE("input_drain_queue");
+
+	int count = queue.size();
+	long long motion_time = 0;
+	bool motion = false;
+
+	for(int i=0; i<count; i++) {
+		InputEvent ev;
+		queue.pop(&ev);
+
+		switch(ev.type) {
+		case IEV_KEYBOARD:
+			event_time = ev.time;
+			input_keyboard(ev.code, ev.pressed);
+			break;
+
+		case IEV_RAY_POINTER:
+			input_set_ray_pointer(ev.ptr, ev.pos, ev.dir, ev.time);
+			motion_time = ev.time;
+			motion = true;
+			break;
+
+		case IEV_3D_POINTER:
+			input_set_3d_pointer(ev.ptr, ev.pos, ev.rot, ev.time);
+			motion_time = ev.time;
+			motion = true;
+			break;
+
+		case IEV_BUTTON:
+			if(motion) {
+				event_time = motion_time;
+				input_process_pointers();
+				motion = false;
+			}
+			event_time = ev.time;
+			input_button(ev.ptr, ev.code, ev.pressed);
+			break;
+		}
+	}
+
+	if(motion) {
+		event_time = motion_time;
+		input_process_pointers();
+	}
+	event_time = 0;
+	return count;
+}
+
+long long input_get_event_time()
+{
+	return event_time;
+}
+
+static void record(int type, int ptr)
+{
+	if(recorder) {
+		InputRecord rec;
+		rec.type = type;
+		rec.ptr = ptr;
+		recorder->write(&rec);
+	}
+}
+
+/* pointers which exist already are recorded as added, so that the replay
+ * has them too
+ */
+bool input_record_start(const char *fname)
+{
+	input_record_stop();
+
+	recorder = new InputLogWriter;
+	if(!recorder->open(fname)) {
+		delete recorder;
+		recorder = 0;
+		return false;
+	}
+
+	init_pointers();
+	int num = pointers.size();
+	for(int i=1; i<num; i++) {
+		if(pointers[i].used) {
+			record(ILOG_ADD_POINTER, i);
+		}
+	}
+	if(display_time) {
+		input_set_display_time(display_time);
+	}
+	return true;
+}
+
+void input_record_stop()
+{
+	delete recorder;
+	recorder = 0;
+}
+
+bool input_is_recording()
+{
+	return recorder != 0;
 }
 
 } // namespace vrtk
@@ -0,0 +1,324 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <string.h>
+#include <stdint.h>
+#include "input_log.h"
+#include "input.h"
+#include "frame_clock.h"
+
+namespace vrtk {
+
+#define MAGIC	"VRTKILOG"
+
+InputLogWriter::InputLogWriter()
+{
+	fp = 0;
+}
+
+InputLogWriter::~InputLogWriter()
+{
+	close();
+}
+
+bool InputLogWriter::open(const char *fname)
+{
+	close();
+	if(!(fp = fopen(fname, "wb"))) {
+		fprintf(stderr, "failed to open input log %s for writing\n", fname);
+		return false;
+	}
+	fwrite(MAGIC, 1, 8, fp);
+
+	start = clock_usec();
+	prev_time = prev_usec = 0;
+	return true;
+}
+
+void InputLogWriter::close()
+{
+	if(fp) {
+		fclose(fp);
+		fp = 0;
+	}
+}
+
+void InputLogWriter::write_uint(unsigned long long x)
+{
+	while(x >= 0x80) {
+		fputc((x & 0x7f) | 0x80, fp);
+		x >>= 7;
+	}
+	fputc(x, fp);
+}
+
+void InputLogWriter::write_int(long long x)
+{
+	write_uint(((unsigned long long)x << 1) ^ (unsigned long long)(x >> (sizeof x * 8 - 1)));
+}
+
+void InputLogWriter::write_float(float x)
+{
+	uint32_t bits;
+	memcpy(&bits, &x, 4);
+	for(int i=0; i<4; i++) {
+		fputc((bits >> (i * 8)) & 0xff, fp);
+	}
+}
+
+void InputLogWriter::write(InputRecord *rec)
+{
+	if(!fp) return;
+
+	rec->time = clock_usec() - start;
+	fputc(rec->type, fp);
+	write_uint(rec->time - prev_time);
+	prev_time = rec->time;
+
+	switch(rec->type) {
+	case ILOG_KEYBOARD:
+		write_int(rec->code);
+		fputc(rec->pressed, fp);
+		break;
+
+	case ILOG_RAY_POINTER:
+	case ILOG_3D_POINTER:
+		write_uint(rec->ptr);
+		write_int(rec->usec - prev_usec);
+		prev_usec = rec->usec;
+		write_float(rec->pos.x);
+		write_float(rec->pos.y);
+		write_float(rec->pos.z);
+		if(rec->type == ILOG_RAY_POINTER) {
+			write_float(rec->dir.x);
+			write_float(rec->dir.y);
+			write_float(rec->dir.z);
+		} else {
+			write_float(rec->rot.x);
+			write_float(rec->rot.y);
+			write_float(rec->rot.z);
+			write_float(rec->rot.w);
+		}
+		break;
+
+	case ILOG_BUTTON:
+		write_uint(rec->ptr);
+		write_uint((rec->code << 1) | (rec->pressed ? 1 : 0));
+		break;
+
+	case ILOG_ADD_POINTER:
+	case ILOG_REMOVE_POINTER:
+		write_uint(rec->ptr);
+		break;
+
+	case ILOG_DISPLAY_TIME:
+		write_int(rec->usec - prev_usec);
+		prev_usec = rec->usec;
+		break;
+
+	default:
+		break;
+	}
+}
+
+
+InputLogReader::InputLogReader()
+{
+	fp = 0;
+}
+
+InputLogReader::~InputLogReader()
+{
+	close();
+}
+
+bool InputLogReader::open(const char *fname)
+{
+	close();
+	if(!(fp = fopen(fname, "rb"))) {
+		fprintf(stderr, "failed to open input log %s\n", fname);
+		return false;
+	}
+
+	char magic[8];
+	if(fread(magic, 1, 8, fp) < 8 || memcmp(magic, MAGIC, 8) != 0) {
+		fprintf(stderr, "%s is not an input log\n", fname);
+		close();
+		return false;
+	}
+	prev_time = prev_usec = 0;
+	return true;
+}
+
+void InputLogReader::close()
+{
+	if(fp) {
+		fclose(fp);
+		fp = 0;
+	}
+}
+
+bool InputLogReader::read_uint(unsigned long long *x)
+{
+	*x = 0;
+	for(int shift=0; shift<64; shift+=7) {
+		int c = fgetc(fp);
+		if(c == -1) return false;
+
+		*x |= (unsigned long long)(c & 0x7f) << shift;
+		if(!(c & 0x80)) return true;
+	}
+	return false;
+}
+
+bool InputLogReader::read_int(long long *x)
+{
+	unsigned long long ux;
+	if(!read_uint(&ux)) return false;
+	*x = (long long)(ux >> 1) ^ -(long long)(ux & 1);
+	return true;
+}
+
+bool InputLogReader::read_float(float *x)
+{
+	unsigned char buf[4];
+	if(fread(buf, 1, 4, fp) < 4) return false;
+
+	uint32_t bits = buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+	memcpy(x, &bits, 4);
+	return true;
+}
+
+bool InputLogReader::read(InputRecord *rec)
+{
+	if(!fp) return false;
+
+	int type = fgetc(fp);
+	if(type == -1 || type >= NUM_ILOG_TYPES) return false;
+	rec->type = type;
+
+	unsigned long long dt, ux;
+	long long dx;
+	if(!read_uint(&dt)) return false;
+	rec->time = prev_time += dt;
+
+	switch(type) {
+	case ILOG_KEYBOARD:
+		if(!read_int(&dx)) return false;
+		rec->code = dx;
+		rec->pressed = fgetc(fp) > 0;
+		break;
+
+	case ILOG_RAY_POINTER:
+	case ILOG_3D_POINTER:
+		if(!read_uint(&ux) || !read_int(&dx)) return false;
+		rec->ptr = ux;
+		rec->usec = prev_usec += dx;
+		if(!read_float(&rec->pos.x) || !read_float(&rec->pos.y) || !read_float(&rec->pos.z)) {
+			return false;
+		}
+		if(type == ILOG_RAY_POINTER) {
+			if(!read_float(&rec->dir.x) || !read_float(&rec->dir.y) || !read_float(&rec->dir.z)) {
+				return false;
+			}
+		} else {
+			if(!read_float(&rec->rot.x) || !read_float(&rec->rot.y) || !read_float(&rec->rot.z) ||
+					!read_float(&rec->rot.w)) {
+				return false;
+			}
+		}
+		break;
+
+	case ILOG_BUTTON:
+		if(!read_uint(&ux)) return false;
+		rec->ptr = ux;
+		if(!read_uint(&ux)) return false;
+		rec->code = ux >> 1;
+		rec->pressed = ux & 1;
+		break;
+
+	case ILOG_ADD_POINTER:
+	case ILOG_REMOVE_POINTER:
+		if(!read_uint(&ux)) return false;
+		rec->ptr = ux;
+		break;
+
+	case ILOG_DISPLAY_TIME:
+		if(!read_int(&dx)) return false;
+		rec->usec = prev_usec += dx;
+		break;
+
+	default:
+		break;
+	}
+	return true;
+}
+
+
+// unknown pointers are taken as the default pointer
+static inline int map_pointer(const std::vector<int> &ptrmap, int id)
+{
+	return id < (int)ptrmap.size() && ptrmap[id] >= 0 ? ptrmap[id] : 0;
+}
+
+void replay_record(const InputRecord &rec, std::vector<int> *ptrmap)
+{
+	switch(rec.type) {
+	case ILOG_KEYBOARD:
+		input_keyboard(rec.code, rec.pressed);
+		break;
+
+	case ILOG_RAY_POINTER:
+		input_set_ray_pointer(map_pointer(*ptrmap, rec.ptr), rec.pos, rec.dir, rec.usec);
+		break;
+
+	case ILOG_3D_POINTER:
+		input_set_3d_pointer(map_pointer(*ptrmap, rec.ptr), rec.pos, rec.rot, rec.usec);
+		break;
+
+	case ILOG_BUTTON:
+		input_button(map_pointer(*ptrmap, rec.ptr), rec.code, rec.pressed);
+		break;
+
+	case ILOG_PROCESS:
+		input_process_pointers();
+		break;
+
+	case ILOG_ADD_POINTER:
+		if(rec.ptr >= (int)ptrmap->size()) {
+			ptrmap->resize(rec.ptr + 1, -1);
+		}
+		(*ptrmap)[rec.ptr] = input_add_pointer();
+		break;
+
+	case ILOG_REMOVE_POINTER:
+		input_remove_pointer(map_pointer(*ptrmap, rec.ptr));
+		if(rec.ptr < (int)ptrmap->size()) {
+			(*ptrmap)[rec.ptr] = -1;
+		}
+		break;
+
+	case ILOG_DISPLAY_TIME:
+		input_set_display_time(rec.usec);
+		break;
+
+	default:
+		break;
+	}
+}
+
+}	// namespace vrtk
@@ -0,0 +1,107 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef INPUT_LOG_H_
+#define INPUT_LOG_H_
+
+#include <stdio.h>
+#include <vector>
+#include <gmath/gmath.h>
+
+namespace vrtk {
+
+/* input log records, one for each call of the input functions which affect
+ * dispatch. Pointer motion is split in setting the pose and processing it,
+ * the way input_ray_pointer and the queue do it.
+ */
+enum {
+	ILOG_KEYBOARD,
+	ILOG_RAY_POINTER,
+	ILOG_3D_POINTER,
+	ILOG_BUTTON,
+	ILOG_PROCESS,
+	ILOG_ADD_POINTER,
+	ILOG_REMOVE_POINTER,
+	ILOG_DISPLAY_TIME,
+
+	NUM_ILOG_TYPES
+};
+
+struct InputRecord {
+	int type;
+	long long time;		// usec since recording started
+	int ptr;
+	int code;		// key or button
+	bool pressed;
+	long long usec;	// pose timestamp, or display time
+	Vec3 pos, dir;
+	Quat rot;
+};
+
+/* Log format: the magic "VRTKILOG", then the records back to back. Each is
+ * the type byte, and the time since the previous record as a varint,
+ * followed by what the type needs: integers as varints (signed ones zigzag
+ * encoded), timestamps as the difference from the previous one, and floats
+ * as 32 bits. Everything is little-endian.
+ */
+class InputLogWriter {
+private:
+	FILE *fp;
+	long long start, prev_time, prev_usec;
+
+	void write_uint(unsigned long long x);
+	void write_int(long long x);
+	void write_float(float x);
+
+public:
+	InputLogWriter();
+	~InputLogWriter();
+
+	bool open(const char *fname);
+	void close();
+
+	void write(InputRecord *rec);	// fills in the time
+};
+
+class InputLogReader {
+private:
+	FILE *fp;
+	long long prev_time, prev_usec;
+
+	bool read_uint(unsigned long long *x);
+	bool read_int(long long *x);
+	bool read_float(float *x);
+
+public:
+	InputLogReader();
+	~InputLogReader();
+
+	bool open(const char *fname);
+	void close();
+
+	// false at the end of the log, or if it's truncated
+	bool read(InputRecord *rec);
+};
+
+/* makes the input call a record stands for. Pointer ids may differ from the
+ * recording, ptrmap maps them, and gets updated as pointers are added.
+ */
+void replay_record(const InputRecord &rec, std::vector<int> *ptrmap);
+
+}	// namespace vrtk
+
+#endif	// INPUT_LOG_H_
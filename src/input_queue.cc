@@ -0,0 +1,61 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "input_queue.h"
+
+namespace vrtk {
+
+InputQueue::InputQueue(int size)
+	: head(0), tail(0)
+{
+	int sz = 1;
+	while(sz < size) sz <<= 1;
+
+	ring.resize(sz);
+	mask = sz - 1;
+}
+
+bool InputQueue::push(const InputEvent &ev)
+{
+	unsigned int h = head.load(std::memory_order_relaxed);
+	if(h - tail.load(std::memory_order_acquire) > mask) {
+		return false;
+	}
+	ring[h & mask] = ev;
+	// publish the event before the index which makes it visible
+	head.store(h + 1, std::memory_order_release);
+	return true;
+}
+
+bool InputQueue::pop(InputEvent *ev)
+{
+	unsigned int t = tail.load(std::memory_order_relaxed);
+	if(t == head.load(std::memory_order_acquire)) {
+		return false;
+	}
+	*ev = ring[t & mask];
+	// done reading the slot before handing it back to the producer
+	tail.store(t + 1, std::memory_order_release);
+	return true;
+}
+
+int InputQueue::size() const
+{
+	return (int)(head.load(std::memory_order_acquire) - tail.load(std::memory_order_relaxed));
+}
+
+}	// namespace vrtk
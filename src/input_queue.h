@@ -0,0 +1,69 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef INPUT_QUEUE_H_
+#define INPUT_QUEUE_H_
+
+#include <atomic>
+#include <vector>
+#include <gmath/gmath.h>
+
+namespace vrtk {
+
+enum {
+	IEV_KEYBOARD,
+	IEV_RAY_POINTER,
+	IEV_3D_POINTER,
+	IEV_BUTTON
+};
+
+struct InputEvent {
+	int type;
+	int ptr;		// pointer id, for pointer and button events
+	int code;		// key or button
+	bool pressed;
+	long long time;	// usec, on the clock of the host
+	Vec3 pos, dir;	// ray origin and direction, or 3D pointer position
+	Quat rot;
+};
+
+/* fixed size ring buffer, for passing events from exactly one producer
+ * thread to exactly one consumer thread, without locks. Each side only
+ * writes its own index, and reads the other with acquire ordering.
+ */
+class InputQueue {
+private:
+	std::vector<InputEvent> ring;
+	unsigned int mask;
+	// on separate cache lines, since each is written by a different thread
+	alignas(64) std::atomic<unsigned int> head;	// next slot to write, producer
+	alignas(64) std::atomic<unsigned int> tail;	// next slot to read, consumer
+
+public:
+	explicit InputQueue(int size = 4096);	// rounded up to a power of two
+
+	// producer side; false if the queue is full and the event was dropped
+	bool push(const InputEvent &ev);
+
+	// consumer side
+	bool pop(InputEvent *ev);
+	int size() const;	// events available to pop, at least
+};
+
+}	// namespace vrtk
+
+#endif	// INPUT_QUEUE_H_
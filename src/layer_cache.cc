@@ -0,0 +1,254 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <math.h>
+#include <float.h>
+#include "opengl.h"
+#include "layer_cache.h"
+#include "glstate.h"
+#include "stats_priv.h"
+
+namespace vrtk {
+
+LayerCache::LayerCache()
+{
+	fbo = tex = zbuf = 0;
+	xsz = ysz = 1024;
+	cos_thres = cos(M_PI / 90.0);	// 2 degrees
+	valid = false;
+}
+
+LayerCache::~LayerCache()
+{
+	destroy();
+}
+
+bool LayerCache::create()
+{
+#ifdef GL_ES_VERSION_2_0
+	return false;
+#else
+	glPushAttrib(GL_TEXTURE_BIT);
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, xsz, ysz, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+	glPopAttrib();
+
+	glGenRenderbuffers(1, &zbuf);
+	glBindRenderbuffer(GL_RENDERBUFFER, zbuf);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, xsz, ysz);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	// called by render, with the previous framebuffer saved
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, zbuf);
+
+	if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		destroy();
+		return false;
+	}
+	return true;
+#endif
+}
+
+void LayerCache::destroy()
+{
+	if(fbo) {
+		gl_delete_framebuffers(1, &fbo);
+		gl_delete_renderbuffers(1, &zbuf);
+		gl_delete_textures(1, &tex);
+		fbo = tex = zbuf = 0;
+	}
+	valid = false;
+}
+
+void LayerCache::set_resolution(int xsz, int ysz)
+{
+	if(xsz != this->xsz || ysz != this->ysz) {
+		this->xsz = xsz;
+		this->ysz = ysz;
+		destroy();
+	}
+}
+
+void LayerCache::set_threshold(float angle)
+{
+	cos_thres = cos(angle);
+}
+
+void LayerCache::invalidate()
+{
+	valid = false;
+}
+
+bool LayerCache::is_valid(const Vec3 &viewer) const
+{
+	if(!valid) return false;
+
+	Vec3 a = viewer - center;
+	Vec3 b = view_pos - center;
+	float lsq = length_sq(a) * length_sq(b);
+	return lsq > 0.0f && dot(a, b) >= cos_thres * sqrt(lsq);
+}
+
+bool LayerCache::render(const AABox &box, const Vec3 &viewer, void (*draw_func)(void*), void *cls)
+{
+#ifdef GL_ES_VERSION_2_0
+	return false;
+#else
+	valid = false;
+
+	Vec3 cent = (box.min + box.max) * 0.5f;
+	Vec3 dir = viewer - cent;
+	float dist = length(dir);
+	if(dist <= 0.0f) return false;
+	Vec3 n = dir / dist;
+
+	// basis of the quad plane, kept upright
+	Vec3 up = fabs(n.y) < 0.99f ? Vec3(0, 1, 0) : Vec3(0, 0, 1);
+	Vec3 right = normalize(cross(up, n));
+	up = cross(n, right);
+
+	/* project the corners of the box onto the quad plane, from the viewer,
+	 * to find the extents of the quad and the depth range
+	 */
+	float umin = FLT_MAX, umax = -FLT_MAX, vmin = FLT_MAX, vmax = -FLT_MAX;
+	float znear = FLT_MAX, zfar = 0.0f;
+	for(int i=0; i<8; i++) {
+		Vec3 c = Vec3(i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y,
+				i & 4 ? box.max.z : box.min.z) - viewer;
+		float z = -dot(c, n);
+		if(z <= 0.0f) return false;
+
+		Vec3 p = c * (dist / z);
+		float u = dot(p, right);
+		float v = dot(p, up);
+		if(u < umin) umin = u;
+		if(u > umax) umax = u;
+		if(v < vmin) vmin = v;
+		if(v > vmax) vmax = v;
+		if(z < znear) znear = z;
+		if(z > zfar) zfar = z;
+	}
+	znear *= 0.99f;
+	zfar *= 1.01f;
+
+	int prev_fbo;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prev_fbo);
+
+	if(fbo) {
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	} else if(!create()) {
+		glBindFramebuffer(GL_FRAMEBUFFER, prev_fbo);
+		return false;
+	}
+
+	glPushAttrib(GL_VIEWPORT_BIT | GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_ENABLE_BIT);
+	glViewport(0, 0, xsz, ysz);
+	glClearColor(0, 0, 0, 0);
+	glDepthMask(1);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glEnable(GL_DEPTH_TEST);
+
+	float s = znear / dist;
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	glFrustum(umin * s, umax * s, vmin * s, vmax * s, znear, zfar);
+
+	float view[] = {
+		right.x, up.x, n.x, 0,
+		right.y, up.y, n.y, 0,
+		right.z, up.z, n.z, 0,
+		-dot(right, viewer), -dot(up, viewer), -dot(n, viewer), 1
+	};
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadMatrixf(view);
+
+	draw_func(cls);
+
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	glPopMatrix();
+	glPopAttrib();
+
+	glPushAttrib(GL_TEXTURE_BIT);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	glPopAttrib();
+
+	glBindFramebuffer(GL_FRAMEBUFFER, prev_fbo);
+
+	quad[0] = cent + right * umin + up * vmin;
+	quad[1] = cent + right * umax + up * vmin;
+	quad[2] = cent + right * umax + up * vmax;
+	quad[3] = cent + right * umin + up * vmax;
+	view_pos = viewer;
+	center = cent;
+	valid = true;
+	return true;
+#endif
+}
+
+void LayerCache::draw() const
+{
+#ifndef GL_ES_VERSION_2_0
+	if(!valid) return;
+
+	unsigned int prog = gl_current_program();
+	gl_use_program(0);
+
+	glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_TEXTURE_BIT | GL_CURRENT_BIT);
+	glDisable(GL_LIGHTING);
+	glDisable(GL_CULL_FACE);
+	glEnable(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+
+	/* rendered over transparent black, with the translucent parts blended to
+	 * premultiplied alpha (see RenderQueue::submit_translucent)
+	 */
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	// keep the empty parts out of the depth buffer
+	glEnable(GL_ALPHA_TEST);
+	glAlphaFunc(GL_GREATER, 0.0f);
+
+	static const float tc[][2] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+	glBegin(GL_QUADS);
+	for(int i=0; i<4; i++) {
+		glTexCoord2fv(tc[i]);
+		glVertex3f(quad[i].x, quad[i].y, quad[i].z);
+	}
+	glEnd();
+	STAT_ADD(STAT_DRAW_CALLS, 1);
+	STAT_ADD(STAT_TRIANGLES, 2);
+
+	glPopAttrib();
+	gl_use_program(prog);
+#endif
+}
+
+}	// namespace vrtk
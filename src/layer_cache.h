@@ -0,0 +1,67 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef LAYER_CACHE_H_
+#define LAYER_CACHE_H_
+
+#include <gmath/gmath.h>
+#include "geom.h"
+
+namespace vrtk {
+
+/* A bounding box of widgets rendered into a texture, as seen from a viewer
+ * position, and shown on a single quad through the center of the box, facing
+ * that position. Like the quad layers of VR compositors: the quad looks the
+ * same as the widgets from where it was rendered, and close enough from
+ * nearby, until the viewer moves more than the parallax threshold away.
+ */
+class LayerCache {
+private:
+	unsigned int fbo, tex, zbuf;
+	int xsz, ysz;
+	float cos_thres;	// cosine of the parallax threshold angle
+
+	bool valid;
+	Vec3 view_pos, center;	// where it was rendered from, and of what
+	Vec3 quad[4];
+
+	bool create();
+	void destroy();
+
+public:
+	LayerCache();
+	~LayerCache();
+
+	void set_resolution(int xsz, int ysz);
+	// maximum angle between viewer positions, as seen from the center
+	void set_threshold(float angle);
+
+	void invalidate();
+	// true if the layer can still be shown to a viewer at this position
+	bool is_valid(const Vec3 &viewer) const;
+
+	/* renders the contents of box into the layer, as seen from viewer, by
+	 * calling draw_func with the render target and the matrices set up.
+	 * Fails if the viewer isn't in front of the whole box (or without FBOs).
+	 */
+	bool render(const AABox &box, const Vec3 &viewer, void (*draw_func)(void*), void *cls);
+	void draw() const;
+};
+
+}	// namespace vrtk
+
+#endif	// LAYER_CACHE_H_
@@ -1,9 +1,13 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <float.h>
 #include <assert.h>
 #include "opengl.h"
 #include "mesh.h"
+#include "glstate.h"
+#include "stats_priv.h"
+#include "trace_priv.h"
 //#include "xform_node.h"
 
 #define USE_OLDGL
@@ -23,40 +27,50 @@ int Mesh::global_sdr_loc[NUM_MESH_ATTR] = { 0, 1, 2, 3, 4, 5, 6 };
 unsigned int Mesh::intersect_mode = ISECT_DEFAULT;
 float Mesh::vertex_sel_dist = 0.01;
 float Mesh::vis_vecsize = 1.0;
+std::atomic<unsigned int> Mesh::next_id(1);
+unsigned int Mesh::sdr_loc_rev;
 
 Mesh::Mesh()
 {
 	clear();
+	id = next_id++;
 
-	glGenBuffers(NUM_MESH_ATTR + 1, buffer_objects);
-
+	// buffer objects are created on first draw, so that meshes can be
+	// built on any thread, without a GL context
+	memset(buffer_objects, 0, sizeof buffer_objects);
 	for(int i=0; i<NUM_MESH_ATTR; i++) {
-		vattr[i].vbo = buffer_objects[i];
+		vattr[i].vbo = 0;
 	}
-	ibo = buffer_objects[NUM_MESH_ATTR];
+	ibo = 0;
 	wire_ibo = 0;
+	vao = 0;
 }
 
 Mesh::~Mesh()
 {
-	glDeleteBuffers(NUM_MESH_ATTR + 1, buffer_objects);
-
+	if(buffer_objects[0]) {
+		gl_delete_buffers(NUM_MESH_ATTR + 1, buffer_objects);
+	}
 	if(wire_ibo) {
-		glDeleteBuffers(1, &wire_ibo);
+		gl_delete_buffers(1, &wire_ibo);
+	}
+	if(vao) {
+		gl_delete_vertex_array(vao);
 	}
 }
 
 Mesh::Mesh(const Mesh &rhs)
 {
 	clear();
+	id = next_id++;
 
-	glGenBuffers(NUM_MESH_ATTR + 1, buffer_objects);
-
+	memset(buffer_objects, 0, sizeof buffer_objects);
 	for(int i=0; i<NUM_MESH_ATTR; i++) {
-		vattr[i].vbo = buffer_objects[i];
+		vattr[i].vbo = 0;
 	}
-	ibo = buffer_objects[NUM_MESH_ATTR];
+	ibo = 0;
 	wire_ibo = 0;
+	vao = 0;
 
 	clone(rhs);
 }
@@ -124,6 +138,11 @@ const char *Mesh::get_name() const
 	return name.c_str();
 }
 
+unsigned int Mesh::get_id() const
+{
+	return id;
+}
+
 bool Mesh::has_attrib(int attr) const
 {
 	if(attr < 0 || attr >= NUM_MESH_ATTR) {
@@ -219,7 +238,7 @@ const float *Mesh::get_attrib_data(int attrib) const
 		Mesh *m = (Mesh*)this;
 		m->vattr[attrib].data.resize(nverts * vattr[attrib].nelem);
 
-		glBindBuffer(GL_ARRAY_BUFFER, vattr[attrib].vbo);
+		gl_bind_buffer(GL_ARRAY_BUFFER, vattr[attrib].vbo);
 		void *data = glMapBuffer(GL_ARRAY_BUFFER, GL_READ_ONLY);
 		memcpy(&m->vattr[attrib].data[0], data, nverts * vattr[attrib].nelem * sizeof(float));
 		glUnmapBuffer(GL_ARRAY_BUFFER);
@@ -306,7 +325,8 @@ const unsigned int *Mesh::get_index_data() const
 		int nidx = nfaces * 3;
 		m->idata.resize(nidx);
 
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+		gl_bind_vertex_array(0);	// don't disturb the binding of a VAO
+		gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
 		void *data = glMapBuffer(GL_ELEMENT_ARRAY_BUFFER, GL_READ_ONLY);
 		memcpy(&m->idata[0], data, nidx * sizeof(unsigned int));
 		glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
@@ -442,6 +462,7 @@ void Mesh::set_attrib_location(int attr, int loc)
 		return;
 	}
 	Mesh::global_sdr_loc[attr] = loc;
+	sdr_loc_rev++;
 }
 
 /// static function
@@ -459,6 +480,7 @@ void Mesh::clear_attrib_locations()
 	for(int i=0; i<NUM_MESH_ATTR; i++) {
 		Mesh::global_sdr_loc[i] = -1;
 	}
+	sdr_loc_rev++;
 }
 
 /// static function
@@ -560,18 +582,11 @@ int Mesh::get_bones_count() const
 }
 */
 
-bool Mesh::pre_draw() const
+/* sets up the vertex arrays for drawing with the current program, or the
+ * fixed-function pipeline. Goes into the VAO when there is one.
+ */
+bool Mesh::setup_arrays() const
 {
-	cur_sdr = 0;
-	glGetIntegerv(GL_CURRENT_PROGRAM, &cur_sdr);
-
-	((Mesh*)this)->update_buffers();
-
-	if(!vattr[MESH_ATTR_VERTEX].vbo_valid) {
-		fprintf(stderr, "%s: invalid vertex buffer\n", __FUNCTION__);
-		return false;
-	}
-
 	if(cur_sdr && use_custom_sdr_attr) {
 		// rendering with shaders
 		if(global_sdr_loc[MESH_ATTR_VERTEX] == -1) {
@@ -579,95 +594,167 @@ bool Mesh::pre_draw() const
 			return false;
 		}
 
+		unsigned int mask = 0;
 		for(int i=0; i<NUM_MESH_ATTR; i++) {
 			int loc = global_sdr_loc[i];
 			if(loc >= 0 && vattr[i].vbo_valid) {
-				glBindBuffer(GL_ARRAY_BUFFER, vattr[i].vbo);
+				gl_bind_buffer(GL_ARRAY_BUFFER, vattr[i].vbo);
 				glVertexAttribPointer(loc, vattr[i].nelem, GL_FLOAT, GL_FALSE, 0, 0);
-				glEnableVertexAttribArray(loc);
+				mask |= 1 << loc;
 			}
 		}
+		gl_set_client_arrays(0);
+		gl_set_attrib_arrays(mask);
 	} else {
 #ifndef GL_ES_VERSION_2_0
 		// rendering with fixed-function (not available in GLES2)
-		glBindBuffer(GL_ARRAY_BUFFER, vattr[MESH_ATTR_VERTEX].vbo);
+		unsigned int mask = GLS_VERTEX_ARRAY;
+
+		gl_bind_buffer(GL_ARRAY_BUFFER, vattr[MESH_ATTR_VERTEX].vbo);
 		glVertexPointer(vattr[MESH_ATTR_VERTEX].nelem, GL_FLOAT, 0, 0);
-		glEnableClientState(GL_VERTEX_ARRAY);
 
 		if(vattr[MESH_ATTR_NORMAL].vbo_valid) {
-			glBindBuffer(GL_ARRAY_BUFFER, vattr[MESH_ATTR_NORMAL].vbo);
+			gl_bind_buffer(GL_ARRAY_BUFFER, vattr[MESH_ATTR_NORMAL].vbo);
 			glNormalPointer(GL_FLOAT, 0, 0);
-			glEnableClientState(GL_NORMAL_ARRAY);
+			mask |= GLS_NORMAL_ARRAY;
 		}
 		if(vattr[MESH_ATTR_TEXCOORD].vbo_valid) {
-			glBindBuffer(GL_ARRAY_BUFFER, vattr[MESH_ATTR_TEXCOORD].vbo);
+			gl_bind_buffer(GL_ARRAY_BUFFER, vattr[MESH_ATTR_TEXCOORD].vbo);
 			glTexCoordPointer(vattr[MESH_ATTR_TEXCOORD].nelem, GL_FLOAT, 0, 0);
-			glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+			mask |= GLS_TEXCOORD_ARRAY;
 		}
 		if(vattr[MESH_ATTR_COLOR].vbo_valid) {
-			glBindBuffer(GL_ARRAY_BUFFER, vattr[MESH_ATTR_COLOR].vbo);
+			gl_bind_buffer(GL_ARRAY_BUFFER, vattr[MESH_ATTR_COLOR].vbo);
 			glColorPointer(vattr[MESH_ATTR_COLOR].nelem, GL_FLOAT, 0, 0);
-			glEnableClientState(GL_COLOR_ARRAY);
+			mask |= GLS_COLOR_ARRAY;
 		}
+		gl_set_attrib_arrays(0);
+		gl_set_client_arrays(mask);
 #endif
 	}
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
+	if(ibo_valid) {
+		gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+	}
+	return true;
+}
+
+/* everything setup_arrays depends on, apart from the shader attribute
+ * locations, packed together to tell when the VAO is out of date
+ */
+unsigned int Mesh::calc_layout() const
+{
+	unsigned int layout = (cur_sdr && use_custom_sdr_attr) ? 1 : 0;
+	if(ibo_valid) {
+		layout |= 2;
+	}
+
+	for(int i=0; i<NUM_MESH_ATTR; i++) {
+		if(vattr[i].vbo_valid) {
+			layout |= (4 | (vattr[i].nelem - 1)) << (2 + i * 3);
+		}
+	}
+	return layout;
+}
+
+bool Mesh::pre_draw() const
+{
+	cur_sdr = gl_current_program();
+
+	((Mesh*)this)->update_buffers();
+
+	if(!vattr[MESH_ATTR_VERTEX].vbo_valid) {
+		fprintf(stderr, "%s: invalid vertex buffer\n", __FUNCTION__);
+		return false;
+	}
+
+	if(!gl_have_vao()) {
+		return setup_arrays();
+	}
+
+	unsigned int layout = calc_layout();
+	if(vao && layout == vao_layout && vao_loc_rev == sdr_loc_rev) {
+		gl_bind_vertex_array(vao);
+		return true;
+	}
+
+	// first draw, or the VAO is out of date: build a new one
+	if(vao) {
+		gl_delete_vertex_array(vao);
+	}
+	glGenVertexArrays(1, &vao);
+	gl_bind_vertex_array(vao, true);
+
+	if(!setup_arrays()) {
+		gl_delete_vertex_array(vao);
+		vao = 0;
+		return false;
+	}
+	vao_layout = layout;
+	vao_loc_rev = sdr_loc_rev;
 	return true;
 }
 
 void Mesh::draw() const
 {
-	if(!pre_draw()) return;
+	if(!bind()) return;
+	draw_bound();
+	unbind();
+}
+
+bool Mesh::bind() const
+{
+	return pre_draw();
+}
+
+void Mesh::draw_bound(int instances) const
+{
+	STAT_ADD(STAT_DRAW_CALLS, 1);
+	STAT_ADD(STAT_TRIANGLES, (ibo_valid ? nfaces : nverts / 3) * instances);
+
+#ifndef GL_ES_VERSION_2_0
+	if(instances > 1) {
+		if(ibo_valid) {
+			glDrawElementsInstanced(GL_TRIANGLES, nfaces * 3, GL_UNSIGNED_INT, 0, instances);
+		} else {
+			glDrawArraysInstanced(GL_TRIANGLES, 0, nverts, instances);
+		}
+		return;
+	}
+#endif
 
 	if(ibo_valid) {
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
 		glDrawElements(GL_TRIANGLES, nfaces * 3, GL_UNSIGNED_INT, 0);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	} else {
 		glDrawArrays(GL_TRIANGLES, 0, nverts);
 	}
+}
 
+void Mesh::unbind() const
+{
 	post_draw();
 }
 
+/* the arrays are disabled and the buffers unbound here instead of at the
+ * end of pre_draw, so that drawing the same mesh repeatedly through bind and
+ * draw_bound, or a different one with the same layout, skips all of that
+ */
 void Mesh::post_draw() const
 {
-	if(cur_sdr && use_custom_sdr_attr) {
-		// rendered with shaders
-		for(int i=0; i<NUM_MESH_ATTR; i++) {
-			int loc = global_sdr_loc[i];
-			if(loc >= 0 && vattr[i].vbo_valid) {
-				glDisableVertexAttribArray(loc);
-			}
-		}
-	} else {
-#ifndef GL_ES_VERSION_2_0
-		// rendered with fixed-function
-		glDisableClientState(GL_VERTEX_ARRAY);
-		if(vattr[MESH_ATTR_NORMAL].vbo_valid) {
-			glDisableClientState(GL_NORMAL_ARRAY);
-		}
-		if(vattr[MESH_ATTR_TEXCOORD].vbo_valid) {
-			glDisableClientState(GL_TEXTURE_COORD_ARRAY);
-		}
-		if(vattr[MESH_ATTR_COLOR].vbo_valid) {
-			glDisableClientState(GL_COLOR_ARRAY);
-		}
-#endif
-	}
+	gl_reset_arrays();
 }
 
 void Mesh::draw_wire() const
 {
-	if(!pre_draw()) return;
-
 	((Mesh*)this)->update_wire_ibo();
 
+	if(!pre_draw()) return;
+
 	int num_faces = get_poly_count();
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, wire_ibo);
+	gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, wire_ibo);
 	glDrawElements(GL_LINES, num_faces * 6, GL_UNSIGNED_INT, 0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	// put back the index buffer of the VAO
+	gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, ibo_valid ? ibo : 0);
 
 	post_draw();
 }
@@ -684,8 +771,7 @@ void Mesh::draw_vertices() const
 void Mesh::draw_normals() const
 {
 #ifdef USE_OLDGL
-	int cur_sdr = 0;
-	glGetIntegerv(GL_CURRENT_PROGRAM, &cur_sdr);
+	unsigned int cur_sdr = gl_current_program();
 
 	Vec3 *varr = (Vec3*)get_attrib_data(MESH_ATTR_VERTEX);
 	Vec3 *norm = (Vec3*)get_attrib_data(MESH_ATTR_NORMAL);
@@ -720,8 +806,7 @@ void Mesh::draw_normals() const
 void Mesh::draw_tangents() const
 {
 #ifdef USE_OLDGL
-	int cur_sdr = 0;
-	glGetIntegerv(GL_CURRENT_PROGRAM, &cur_sdr);
+	unsigned int cur_sdr = gl_current_program();
 
 	Vec3 *varr = (Vec3*)get_attrib_data(MESH_ATTR_VERTEX);
 	Vec3 *tang = (Vec3*)get_attrib_data(MESH_ATTR_TANGENT);
@@ -814,6 +899,8 @@ float Mesh::get_vertex_select_distance()
 
 bool Mesh::intersect(const Ray &ray, HitPoint *hit) const
 {
+	TRACE_ZONE("Mesh::intersect");
+
 	assert((Mesh::intersect_mode & (ISECT_VERTICES | ISECT_FACE)) != (ISECT_VERTICES | ISECT_FACE));
 
 	const Vec3 *varr = (Vec3*)get_attrib_data(MESH_ATTR_VERTEX);
@@ -880,6 +967,7 @@ bool Mesh::intersect(const Ray &ray, HitPoint *hit) const
 			HitPoint fhit;
 			if(face.intersect(ray, hit ? &fhit : 0)) {
 				if(!hit) {
+					STAT_ADD(STAT_TRIS_TESTED, i + 1);
 					return true;
 				}
 				if(fhit.t < nearest_hit.t) {
@@ -888,6 +976,7 @@ bool Mesh::intersect(const Ray &ray, HitPoint *hit) const
 				}
 			}
 		}
+		STAT_ADD(STAT_TRIS_TESTED, nfaces);
 	}
 
 	if(nearest_hit.obj) {
@@ -1170,21 +1259,37 @@ void Mesh::calc_bsph()
 
 void Mesh::update_buffers()
 {
+	TRACE_ZONE("Mesh::update_buffers");
+
+	if(!buffer_objects[0]) {
+		glGenBuffers(NUM_MESH_ATTR + 1, buffer_objects);
+
+		for(int i=0; i<NUM_MESH_ATTR; i++) {
+			vattr[i].vbo = buffer_objects[i];
+		}
+		ibo = buffer_objects[NUM_MESH_ATTR];
+	}
+
 	for(int i=0; i<NUM_MESH_ATTR; i++) {
 		if(has_attrib(i) && !vattr[i].vbo_valid) {
-			glBindBuffer(GL_ARRAY_BUFFER, vattr[i].vbo);
-			glBufferData(GL_ARRAY_BUFFER, nverts * vattr[i].nelem * sizeof(float), &vattr[i].data[0], GL_STATIC_DRAW);
+			gl_bind_buffer(GL_ARRAY_BUFFER, vattr[i].vbo);
+			long sz = nverts * vattr[i].nelem * sizeof(float);
+			glBufferData(GL_ARRAY_BUFFER, sz, &vattr[i].data[0], GL_STATIC_DRAW);
 			vattr[i].vbo_valid = true;
+			STAT_ADD(STAT_UPLOADS, 1);
+			STAT_ADD(STAT_UPLOAD_BYTES, sz);
 		}
 	}
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 	if(idata_valid && !ibo_valid) {
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, nfaces * 3 * sizeof(unsigned int), &idata[0], GL_STATIC_DRAW);
+		gl_bind_vertex_array(0);	// don't disturb the binding of a VAO
+		gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+		long sz = nfaces * 3 * sizeof(unsigned int);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sz, &idata[0], GL_STATIC_DRAW);
 		ibo_valid = true;
+		STAT_ADD(STAT_UPLOADS, 1);
+		STAT_ADD(STAT_UPLOAD_BYTES, sz);
 	}
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
 void Mesh::update_wire_ibo()
@@ -1230,11 +1335,12 @@ void Mesh::update_wire_ibo()
 		}
 	}
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, wire_ibo);
+	gl_bind_vertex_array(0);	// don't disturb the binding of a VAO
+	gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, wire_ibo);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, num_faces * 6 * sizeof(unsigned int), wire_idxarr, GL_STATIC_DRAW);
 	delete [] wire_idxarr;
 	wire_ibo_valid = true;
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
 
@@ -1299,14 +1405,22 @@ void Triangle::draw() const
 	int vloc = Mesh::get_attrib_location(MESH_ATTR_VERTEX);
 	int nloc = Mesh::get_attrib_location(MESH_ATTR_NORMAL);
 
-	glEnableVertexAttribArray(vloc);
-	glVertexAttribPointer(vloc, 3, GL_FLOAT, GL_FALSE, 0, &v[0].x);
-	glVertexAttribPointer(nloc, 3, GL_FLOAT, GL_FALSE, 0, &n[0].x);
+	// unset locations (-1) are left out
+	unsigned int mask = 0;
+	gl_bind_buffer(GL_ARRAY_BUFFER, 0);
+	if(vloc >= 0) {
+		glVertexAttribPointer(vloc, 3, GL_FLOAT, GL_FALSE, 0, &v[0].x);
+		mask |= 1 << vloc;
+	}
+	if(nloc >= 0) {
+		glVertexAttribPointer(nloc, 3, GL_FLOAT, GL_FALSE, 0, &n[0].x);
+		mask |= 1 << nloc;
+	}
+	gl_set_attrib_arrays(mask);
 
 	glDrawArrays(GL_TRIANGLES, 0, 3);
 
-	glDisableVertexAttribArray(vloc);
-	glDisableVertexAttribArray(nloc);
+	gl_set_attrib_arrays(0);
 }
 
 void Triangle::draw_wire() const
@@ -1314,12 +1428,18 @@ void Triangle::draw_wire() const
 	static const int idxarr[] = {0, 1, 1, 2, 2, 0};
 	int vloc = Mesh::get_attrib_location(MESH_ATTR_VERTEX);
 
-	glEnableVertexAttribArray(vloc);
-	glVertexAttribPointer(vloc, 3, GL_FLOAT, GL_FALSE, 0, &v[0].x);
+	gl_bind_buffer(GL_ARRAY_BUFFER, 0);
+	gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	unsigned int mask = 0;
+	if(vloc >= 0) {
+		glVertexAttribPointer(vloc, 3, GL_FLOAT, GL_FALSE, 0, &v[0].x);
+		mask = 1 << vloc;
+	}
+	gl_set_attrib_arrays(mask);
 
 	glDrawElements(GL_LINES, 6, GL_UNSIGNED_INT, idxarr);
 
-	glDisableVertexAttribArray(vloc);
+	gl_set_attrib_arrays(0);
 }
 
 Vec3 Triangle::calc_barycentric(const Vec3 &pos) const
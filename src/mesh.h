@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <string>
 #include <vector>
+#include <atomic>
 #include <gmath/gmath.h>
 #include "geom.h"
 
@@ -64,6 +65,9 @@ private:
 	std::string name;
 	unsigned int nverts, nfaces;
 
+	unsigned int id;	// unique per mesh, for render queue sorting
+	static std::atomic<unsigned int> next_id;
+
 	// current value for each attribute for the immedate mode
 	// interface.
 	Vec4 cur_val[NUM_MESH_ATTR];
@@ -120,7 +124,17 @@ private:
 	/// construct/update the wireframe index buffer (called from draw_wire).
 	void update_wire_ibo();
 
+	/* vertex array object, and what it was built for. Rebuilt when either
+	 * the attribute layout or the shader attribute locations change.
+	 */
+	mutable unsigned int vao;
+	mutable unsigned int vao_layout, vao_loc_rev;
+	static unsigned int sdr_loc_rev;
+
+	unsigned int calc_layout() const;
+
 	mutable int cur_sdr;
+	bool setup_arrays() const;
 	bool pre_draw() const;
 	void post_draw() const;
 
@@ -138,6 +152,8 @@ public:
 	void set_name(const char *name);
 	const char *get_name() const;
 
+	unsigned int get_id() const;
+
 	bool has_attrib(int attr) const;
 	bool is_indexed() const;
 
@@ -200,6 +216,16 @@ public:
 
 	void draw() const;
 	void draw_wire() const;
+
+	/* draw() split in three, for drawing the same mesh many times in a row:
+	 * bind sets up the buffers and vertex attributes, draw_bound only issues
+	 * the draw call, and unbind undoes the setup. draw_bound can draw more
+	 * than one instance, for programs which use the instance id.
+	 */
+	bool bind() const;
+	void draw_bound(int instances = 1) const;
+	void unbind() const;
+
 	void draw_vertices() const;
 	void draw_normals() const;
 	void draw_tangents() const;
@@ -0,0 +1,395 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <string.h>
+#include <limits.h>
+#include <stddef.h>
+#include <algorithm>
+#include "opengl.h"
+#include "mesh_batch.h"
+#include "render_queue.h"
+#include "widget_priv.h"
+#include "shape.h"
+#include "mesh.h"
+#include "glstate.h"
+#include "stats_priv.h"
+
+namespace vrtk {
+
+static inline void add_range(int *start, int *end, int s, int e)
+{
+	if(s < *start) *start = s;
+	if(e > *end) *end = e;
+}
+
+MeshBatch::MeshBatch()
+{
+	num_unused_verts = 0;
+	vbo = ibo = 0;
+	vbo_size = ibo_size = 0;
+	vdirty_start = idirty_start = INT_MAX;
+	vdirty_end = idirty_end = 0;
+	num_tris = 0;
+}
+
+MeshBatch::~MeshBatch()
+{
+	int num = entries.size();
+	for(int i=0; i<num; i++) {
+		widget_priv(entries[i].widget)->batch_idx = -1;
+	}
+
+	if(vbo) {
+		unsigned int bufs[] = {vbo, ibo};
+		gl_delete_buffers(2, bufs);
+	}
+}
+
+void MeshBatch::add(Widget *w)
+{
+	WidgetPriv *wpriv = widget_priv(w);
+	if(wpriv->batch_idx >= 0) return;
+
+	Entry ent;
+	ent.widget = w;
+	ent.visible = false;
+
+	wpriv->batch_idx = entries.size();
+	entries.push_back(ent);
+	append(&entries.back());
+}
+
+void MeshBatch::remove(Widget *w)
+{
+	WidgetPriv *wpriv = widget_priv(w);
+	int idx = wpriv->batch_idx;
+	if(idx < 0) return;
+
+	// its vertices stay where they are, until the next repack
+	num_unused_verts += entries[idx].vcount;
+
+	entries[idx] = entries.back();
+	widget_priv(entries[idx].widget)->batch_idx = idx;
+	entries.pop_back();
+
+	wpriv->batch_idx = -1;
+}
+
+bool MeshBatch::contains(const Widget *w) const
+{
+	return widget_priv(w)->batch_idx >= 0;
+}
+
+int MeshBatch::size() const
+{
+	return (int)entries.size();
+}
+
+/* takes a snapshot of the widget state, and bakes it into new space at the
+ * end of the arrays
+ */
+void MeshBatch::append(Entry *ent)
+{
+	Widget *w = ent->widget;
+	Shape *shape = w->get_shape();
+
+	ent->mesh = shape->get_mesh();
+	ent->shape_rev = shape->get_revision();
+	ent->xform = w->get_world_xform();
+	ent->color = pack_color(w->get_color());
+
+	ent->vstart = verts.size();
+	ent->vcount = ent->mesh->get_attrib_count(MESH_ATTR_VERTEX);
+	ent->istart = indices.size();
+	ent->icount = ent->mesh->is_indexed() ? ent->mesh->get_index_count() : ent->vcount;
+
+	verts.resize(ent->vstart + ent->vcount);
+	indices.resize(ent->istart + ent->icount);
+
+	bake(ent, true);
+}
+
+void MeshBatch::bake(const Entry *ent, bool geom)
+{
+	const Mesh *mesh = ent->mesh;
+	const Mat4 &xform = ent->xform;
+	Mat4 norm_xform = transpose(ent->widget->get_inv_world_xform()).upper3x3();
+	bool has_norm = mesh->has_attrib(MESH_ATTR_NORMAL);
+
+	unsigned char col[4];
+	for(int i=0; i<4; i++) {
+		col[i] = (ent->color >> (24 - i * 8)) & 0xff;
+	}
+
+	Vertex *vptr = &verts[ent->vstart];
+	for(int i=0; i<ent->vcount; i++) {
+		Vec3 pos = xform * Vec3(mesh->get_attrib(MESH_ATTR_VERTEX, i));
+		Vec3 norm = Vec3(0, 0, 1);
+		if(has_norm) {
+			norm = normalize(norm_xform * Vec3(mesh->get_attrib(MESH_ATTR_NORMAL, i)));
+		}
+
+		vptr->pos[0] = pos.x;
+		vptr->pos[1] = pos.y;
+		vptr->pos[2] = pos.z;
+		vptr->norm[0] = norm.x;
+		vptr->norm[1] = norm.y;
+		vptr->norm[2] = norm.z;
+		memcpy(vptr->color, col, 4);
+		vptr++;
+	}
+	add_range(&vdirty_start, &vdirty_end, ent->vstart, ent->vstart + ent->vcount);
+
+	if(geom) {
+		unsigned int *iptr = &indices[ent->istart];
+		const unsigned int *src = mesh->is_indexed() ? mesh->get_index_data() : 0;
+
+		for(int i=0; i<ent->icount; i++) {
+			*iptr++ = (src ? src[i] : i) + ent->vstart;
+		}
+		add_range(&idirty_start, &idirty_end, ent->istart, ent->istart + ent->icount);
+	}
+}
+
+void MeshBatch::repack()
+{
+	verts.clear();
+	indices.clear();
+	num_unused_verts = 0;
+
+	int num = entries.size();
+	for(int i=0; i<num; i++) {
+		append(&entries[i]);
+	}
+}
+
+void MeshBatch::update_entry(Entry *ent)
+{
+	Widget *w = ent->widget;
+	Shape *shape = w->get_shape();
+	const Mesh *mesh = shape->get_mesh();
+
+	if(mesh != ent->mesh || shape->get_revision() != ent->shape_rev) {
+		int vcount = mesh->get_attrib_count(MESH_ATTR_VERTEX);
+		int icount = mesh->is_indexed() ? mesh->get_index_count() : vcount;
+
+		if(vcount == ent->vcount && icount == ent->icount) {
+			ent->mesh = mesh;
+			ent->shape_rev = shape->get_revision();
+			ent->xform = w->get_world_xform();
+			ent->color = pack_color(w->get_color());
+			bake(ent, true);
+		} else {
+			num_unused_verts += ent->vcount;
+			append(ent);
+		}
+		return;
+	}
+
+	const Mat4 &xform = w->get_world_xform();
+	unsigned int color = pack_color(w->get_color());
+	if(color != ent->color || memcmp(&xform, &ent->xform, sizeof xform) != 0) {
+		ent->xform = xform;
+		ent->color = color;
+		bake(ent, false);
+	}
+}
+
+void MeshBatch::update()
+{
+	int num = entries.size();
+	for(int i=0; i<num; i++) {
+		update_entry(&entries[i]);
+	}
+
+	if(num_unused_verts > (int)verts.size() / 2) {
+		repack();
+	}
+}
+
+void MeshBatch::update(const Widget *w)
+{
+	int idx = widget_priv(w)->batch_idx;
+	if(idx < 0) return;
+
+	update_entry(&entries[idx]);
+
+	if(num_unused_verts > (int)verts.size() / 2) {
+		repack();
+	}
+}
+
+void MeshBatch::set_visible(const Widget *w, bool vis)
+{
+	int idx = widget_priv(w)->batch_idx;
+	if(idx >= 0) {
+		entries[idx].visible = vis;
+	}
+}
+
+bool MeshBatch::need_upload() const
+{
+	return vdirty_start < vdirty_end || idirty_start < idirty_end ||
+		(int)verts.size() > vbo_size || (int)indices.size() > ibo_size;
+}
+
+void MeshBatch::upload()
+{
+	if(!vbo) {
+		unsigned int bufs[2];
+		glGenBuffers(2, bufs);
+		vbo = bufs[0];
+		ibo = bufs[1];
+	}
+
+	gl_bind_vertex_array(0);	// don't disturb the binding of a VAO
+
+	int nverts = verts.size();
+	gl_bind_buffer(GL_ARRAY_BUFFER, vbo);
+	if(nverts > vbo_size) {
+		vbo_size = verts.capacity();
+		glBufferData(GL_ARRAY_BUFFER, vbo_size * sizeof(Vertex), 0, GL_DYNAMIC_DRAW);
+		vdirty_start = 0;
+		vdirty_end = nverts;
+	}
+	if(vdirty_start < vdirty_end) {
+		long sz = (vdirty_end - vdirty_start) * sizeof(Vertex);
+		glBufferSubData(GL_ARRAY_BUFFER, vdirty_start * sizeof(Vertex), sz, &verts[vdirty_start]);
+		STAT_ADD(STAT_UPLOADS, 1);
+		STAT_ADD(STAT_UPLOAD_BYTES, sz);
+	}
+
+	int nidx = indices.size();
+	gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+	if(nidx > ibo_size) {
+		ibo_size = indices.capacity();
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, ibo_size * sizeof(unsigned int), 0, GL_DYNAMIC_DRAW);
+		idirty_start = 0;
+		idirty_end = nidx;
+	}
+	if(idirty_start < idirty_end) {
+		long sz = (idirty_end - idirty_start) * sizeof(unsigned int);
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, idirty_start * sizeof(unsigned int), sz, &indices[idirty_start]);
+		STAT_ADD(STAT_UPLOADS, 1);
+		STAT_ADD(STAT_UPLOAD_BYTES, sz);
+	}
+
+	vdirty_start = idirty_start = INT_MAX;
+	vdirty_end = idirty_end = 0;
+}
+
+static bool cmp_istart(const std::pair<int, int> &a, const std::pair<int, int> &b)
+{
+	return a.first < b.first;
+}
+
+void MeshBatch::prepare()
+{
+	// index ranges of the visible widgets, merging adjacent ones
+	ranges.clear();
+	counts.clear();
+	offsets.clear();
+	num_tris = 0;
+
+	int num = entries.size();
+	for(int i=0; i<num; i++) {
+		if(entries[i].visible) {
+			ranges.push_back(std::make_pair(entries[i].istart, entries[i].icount));
+		}
+	}
+	std::sort(ranges.begin(), ranges.end(), cmp_istart);
+
+	int num_ranges = ranges.size();
+	for(int i=0; i<num_ranges; i++) {
+		num_tris += ranges[i].second / 3;
+		if(!counts.empty() && ranges[i - 1].first + ranges[i - 1].second == ranges[i].first) {
+			counts.back() += ranges[i].second;
+		} else {
+			counts.push_back(ranges[i].second);
+			offsets.push_back((const void*)(ranges[i].first * sizeof(unsigned int)));
+		}
+	}
+}
+
+void MeshBatch::draw(int instances)
+{
+	if(counts.empty()) return;
+
+	upload();
+
+	unsigned int sdr = gl_current_program();
+	int stride = sizeof(Vertex);
+
+	gl_bind_buffer(GL_ARRAY_BUFFER, vbo);
+	if(sdr && Mesh::use_custom_sdr_attr) {
+		unsigned int mask = 0;
+		int vloc = Mesh::get_attrib_location(MESH_ATTR_VERTEX);
+		int nloc = Mesh::get_attrib_location(MESH_ATTR_NORMAL);
+		int cloc = Mesh::get_attrib_location(MESH_ATTR_COLOR);
+
+		if(vloc < 0) return;
+		glVertexAttribPointer(vloc, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, pos));
+		mask |= 1 << vloc;
+		if(nloc >= 0) {
+			glVertexAttribPointer(nloc, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, norm));
+			mask |= 1 << nloc;
+		}
+		if(cloc >= 0) {
+			glVertexAttribPointer(cloc, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)offsetof(Vertex, color));
+			mask |= 1 << cloc;
+		}
+		gl_set_client_arrays(0);
+		gl_set_attrib_arrays(mask);
+	} else {
+#ifndef GL_ES_VERSION_2_0
+		glVertexPointer(3, GL_FLOAT, stride, (void*)offsetof(Vertex, pos));
+		glNormalPointer(GL_FLOAT, stride, (void*)offsetof(Vertex, norm));
+		glColorPointer(4, GL_UNSIGNED_BYTE, stride, (void*)offsetof(Vertex, color));
+		// the current color is undefined after drawing with a color array
+		glPushAttrib(GL_CURRENT_BIT);
+		gl_set_attrib_arrays(0);
+		gl_set_client_arrays(GLS_VERTEX_ARRAY | GLS_NORMAL_ARRAY | GLS_COLOR_ARRAY);
+#endif
+	}
+
+	int ndraws = counts.size();
+	STAT_ADD(STAT_DRAW_CALLS, ndraws);
+	STAT_ADD(STAT_TRIANGLES, num_tris * instances);
+
+#ifdef GL_ES_VERSION_2_0
+	for(int i=0; i<ndraws; i++) {
+		glDrawElements(GL_TRIANGLES, counts[i], GL_UNSIGNED_INT, offsets[i]);
+	}
+#else
+	if(instances > 1) {
+		// there is no instanced multi-draw without indirect buffers
+		for(int i=0; i<ndraws; i++) {
+			glDrawElementsInstanced(GL_TRIANGLES, counts[i], GL_UNSIGNED_INT, offsets[i], instances);
+		}
+	} else {
+		glMultiDrawElements(GL_TRIANGLES, &counts[0], GL_UNSIGNED_INT, &offsets[0], ndraws);
+	}
+
+	if(!sdr || !Mesh::use_custom_sdr_attr) {
+		glPopAttrib();
+	}
+#endif
+
+	gl_reset_arrays();
+}
+
+}	// namespace vrtk
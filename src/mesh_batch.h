@@ -0,0 +1,108 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef MESH_BATCH_H_
+#define MESH_BATCH_H_
+
+#include <vector>
+#include <utility>
+#include <gmath/gmath.h>
+
+namespace vrtk {
+
+class Widget;
+class Mesh;
+
+/* The meshes of many widgets packed into one vertex and one index buffer,
+ * with the world transformation and color of each widget baked into its
+ * vertices. Any subset of them is drawn with a single glMultiDrawElements,
+ * using whichever program is bound (or the fixed-function pipeline).
+ *
+ * Adding a widget appends its vertices. Removing one leaves a hole, which is
+ * reclaimed by repacking everything once holes take up more than half the
+ * buffers. Only the changed range is uploaded.
+ */
+class MeshBatch {
+private:
+	struct Vertex {
+		float pos[3];
+		float norm[3];
+		unsigned char color[4];
+	};
+
+	struct Entry {
+		Widget *widget;
+		const Mesh *mesh;
+		unsigned int shape_rev;
+		Mat4 xform;
+		unsigned int color;
+		int vstart, vcount;
+		int istart, icount;
+		bool visible;
+	};
+
+	std::vector<Entry> entries;
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+	int num_unused_verts;
+
+	unsigned int vbo, ibo;
+	int vbo_size, ibo_size;		// allocated size in vertices and indices
+	// ranges of verts and indices which need uploading
+	int vdirty_start, vdirty_end, idirty_start, idirty_end;
+
+	// scratch arrays for draw
+	std::vector<std::pair<int, int> > ranges;
+	std::vector<int> counts;
+	std::vector<const void*> offsets;
+	long num_tris;	// in all the ranges drawn
+
+	void append(Entry *ent);
+	void bake(const Entry *ent, bool geom);
+	void update_entry(Entry *ent);
+	void repack();
+	void upload();
+
+public:
+	MeshBatch();
+	~MeshBatch();
+
+	// widgets must have a shape with a mesh
+	void add(Widget *w);
+	void remove(Widget *w);
+	bool contains(const Widget *w) const;
+	int size() const;
+
+	/* re-bakes the widgets which moved, changed color, or changed shape
+	 * since the last update, or just the one given
+	 */
+	void update();
+	void update(const Widget *w);
+
+	/* prepare collects the widgets marked visible, which stay marked until
+	 * changed. draw draws those, as many times as it's called.
+	 */
+	void set_visible(const Widget *w, bool vis = true);
+	void prepare();
+	void draw(int instances = 1);
+
+	bool need_upload() const;	// changes not uploaded by draw yet
+};
+
+}	// namespace vrtk
+
+#endif	// MESH_BATCH_H_
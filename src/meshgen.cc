@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include "meshgen.h"
 #include "mesh.h"
+#include "trace_priv.h"
 
 namespace vrtk {
 
@@ -18,6 +19,8 @@ static Vec3 sphvec(float theta, float phi)
 
 void gen_sphere(Mesh *mesh, float rad, int usub, int vsub, float urange, float vrange)
 {
+	TRACE_ZONE("gen_sphere");
+
 	if(urange == 0.0 || vrange == 0.0) return;
 
 	if(usub < 4) usub = 4;
@@ -137,6 +140,8 @@ static void geosphere(std::vector<Vec3> *verts, const Vec3 &v1, const Vec3 &v2,
 
 void gen_geosphere(Mesh *mesh, float rad, int subdiv, bool hemi)
 {
+	TRACE_ZONE("gen_geosphere");
+
 	int num_tri = (sizeof icosa_idx / sizeof *icosa_idx) / 3;
 
 	std::vector<Vec3> verts;
@@ -196,6 +201,8 @@ static Vec3 torusvec(float theta, float phi, float mr, float rr)
 
 void gen_torus(Mesh *mesh, float mainrad, float ringrad, int usub, int vsub, float urange, float vrange)
 {
+	TRACE_ZONE("gen_torus");
+
 	if(usub < 4) usub = 4;
 	if(vsub < 2) vsub = 2;
 
@@ -263,6 +270,8 @@ static Vec3 cylvec(float theta, float height)
 
 void gen_cylinder(Mesh *mesh, float rad, float height, int usub, int vsub, int capsub, float urange, float vrange)
 {
+	TRACE_ZONE("gen_cylinder");
+
 	if(usub < 4) usub = 4;
 	if(vsub < 1) vsub = 1;
 
@@ -388,6 +397,8 @@ void gen_cylinder(Mesh *mesh, float rad, float height, int usub, int vsub, int c
 
 void gen_capsule(Mesh *mesh, float rad, float height, int usub, int vsub)
 {
+	TRACE_ZONE("gen_capsule");
+
 	gen_cylinder(mesh, rad, height, usub, vsub);
 
 	Mesh tmp;
@@ -414,6 +425,8 @@ static Vec3 conevec(float theta, float y, float height)
 
 void gen_cone(Mesh *mesh, float rad, float height, int usub, int vsub, int capsub, float urange, float vrange)
 {
+	TRACE_ZONE("gen_cone");
+
 	if(usub < 4) usub = 4;
 	if(vsub < 1) vsub = 1;
 
@@ -529,6 +542,8 @@ void gen_cone(Mesh *mesh, float rad, float height, int usub, int vsub, int capsu
 
 void gen_plane(Mesh *mesh, float width, float height, int usub, int vsub)
 {
+	TRACE_ZONE("gen_plane");
+
 	gen_heightmap(mesh, width, height, usub, vsub, 0);
 }
 
@@ -537,6 +552,8 @@ void gen_plane(Mesh *mesh, float width, float height, int usub, int vsub)
 
 void gen_heightmap(Mesh *mesh, float width, float height, int usub, int vsub, float (*hf)(float, float, void*), void *hfdata)
 {
+	TRACE_ZONE("gen_heightmap");
+
 	if(usub < 1) usub = 1;
 	if(vsub < 1) vsub = 1;
 
@@ -602,6 +619,8 @@ void gen_heightmap(Mesh *mesh, float width, float height, int usub, int vsub, fl
 // ----- box ------
 void gen_box(Mesh *mesh, float xsz, float ysz, float zsz, int usub, int vsub)
 {
+	TRACE_ZONE("gen_box");
+
 	static const float face_angles[][2] = {
 		{0, 0},
 		{M_PI / 2.0, 0},
@@ -637,6 +656,8 @@ void gen_box(Mesh *mesh, float xsz, float ysz, float zsz, int usub, int vsub)
 /*
 void gen_box(Mesh *mesh, float xsz, float ysz, float zsz)
 {
+	TRACE_ZONE("gen_box");
+
 	mesh->clear();
 
 	const int num_faces = 6;
@@ -747,6 +768,8 @@ void gen_revol(Mesh *mesh, int usub, int vsub, Vec2 (*rfunc)(float, float, void*
 void gen_revol(Mesh *mesh, int usub, int vsub, Vec2 (*rfunc)(float, float, void*),
 		Vec2 (*nfunc)(float, float, void*), void *cls)
 {
+	TRACE_ZONE("gen_revol");
+
 	if(!rfunc) return;
 	if(usub < 3) usub = 3;
 	if(vsub < 1) vsub = 1;
@@ -835,6 +858,8 @@ static inline Vec3 sweep_vert(float u, float v, float height, Vec2 (*sf)(float,
 // ---- sweep shape along a path ----
 void gen_sweep(Mesh *mesh, float height, int usub, int vsub, Vec2 (*sfunc)(float, float, void*), void *cls)
 {
+	TRACE_ZONE("gen_sweep");
+
 	if(!sfunc) return;
 	if(usub < 3) usub = 3;
 	if(vsub < 1) vsub = 1;
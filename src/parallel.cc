@@ -0,0 +1,164 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include "parallel.h"
+#include "scene.h"
+
+namespace vrtk {
+
+struct Job {
+	void (*func)(int, int, void*);
+	void *cls;
+	int count, range;
+
+	std::atomic<int> next;	// start of the next unclaimed range
+	std::atomic<int> done;	// number of items completed
+	int users;				// workers holding a pointer to the job
+};
+
+static std::vector<std::thread> workers;
+static std::mutex mutex, call_mutex;
+static std::condition_variable job_cond, done_cond;
+static Job *cur_job;
+static unsigned int job_seq;
+static bool quit;
+
+// joins any remaining workers on exit, before the statics above go away
+static struct WorkerCleanup {
+	~WorkerCleanup() { set_num_threads(0); }
+} worker_cleanup;
+
+static void run_ranges(Job *job)
+{
+	int start;
+	while((start = job->next.fetch_add(job->range)) < job->count) {
+		int end = start + job->range;
+		if(end > job->count) end = job->count;
+
+		job->func(start, end, job->cls);
+
+		if(job->done.fetch_add(end - start) + end - start == job->count) {
+			std::lock_guard<std::mutex> lock(mutex);
+			done_cond.notify_all();
+		}
+	}
+}
+
+static void worker_func()
+{
+	unsigned int seen_seq = 0;
+
+	for(;;) {
+		Job *job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while(!quit && (!cur_job || job_seq == seen_seq)) {
+				job_cond.wait(lock);
+			}
+			if(quit) return;
+
+			seen_seq = job_seq;
+			job = cur_job;
+			job->users++;
+		}
+
+		run_ranges(job);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if(--job->users == 0) {
+			done_cond.notify_all();
+		}
+	}
+}
+
+void set_num_threads(int n)
+{
+	if(n < 0) n = 0;
+	if(n == (int)workers.size()) return;
+
+	std::lock_guard<std::mutex> call_lock(call_mutex);
+
+	// stop the current workers and start over
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	job_cond.notify_all();
+	for(size_t i=0; i<workers.size(); i++) {
+		workers[i].join();
+	}
+	workers.clear();
+	quit = false;
+
+	for(int i=0; i<n; i++) {
+		workers.push_back(std::thread(worker_func));
+	}
+}
+
+int get_num_threads()
+{
+	return (int)workers.size();
+}
+
+void parallel_for(int count, int min_range, void (*func)(int, int, void*), void *cls)
+{
+	if(count <= 0) return;
+	if(min_range < 1) min_range = 1;
+
+	if(workers.empty() || count <= min_range) {
+		func(0, count, cls);
+		return;
+	}
+
+	std::lock_guard<std::mutex> call_lock(call_mutex);
+
+	// a few ranges per thread, to balance uneven ranges
+	int nthr = (int)workers.size() + 1;
+	int range = count / (nthr * 4);
+	if(range < min_range) range = min_range;
+
+	Job job;
+	job.func = func;
+	job.cls = cls;
+	job.count = count;
+	job.range = range;
+	job.next = 0;
+	job.done = 0;
+	job.users = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		cur_job = &job;
+		job_seq++;
+	}
+	job_cond.notify_all();
+
+	run_ranges(&job);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	while(job.done < count || job.users > 0) {
+		done_cond.wait(lock);
+	}
+	cur_job = 0;
+}
+
+}	// namespace vrtk
@@ -0,0 +1,35 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef PARALLEL_H_
+#define PARALLEL_H_
+
+namespace vrtk {
+
+/* calls func(start, end, cls) for consecutive ranges, of at least min_range
+ * items each, covering [0, count). The ranges are spread over the worker
+ * threads (see set_num_threads in scene.h) and the calling thread, and
+ * parallel_for returns when all of them are done. With no worker threads,
+ * or too few items, func is called once for the whole range.
+ *
+ * Not reentrant: func must not call parallel_for.
+ */
+void parallel_for(int count, int min_range, void (*func)(int, int, void*), void *cls = 0);
+
+}	// namespace vrtk
+
+#endif	// PARALLEL_H_
@@ -0,0 +1,95 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdlib.h>
+#include <new>
+#include <mutex>
+#include "pool.h"
+
+namespace vrtk {
+
+#define GRANULE			16
+#define NUM_CLASSES		(POOL_MAX_SIZE / GRANULE)
+#define CHUNK_SIZE		65536
+
+struct FreeBlock {
+	FreeBlock *next;
+};
+
+// chunks are never returned to the system, they're kept for reuse
+static FreeBlock *free_list[NUM_CLASSES];
+static std::mutex pool_mutex;
+
+static inline int size_class(size_t sz)
+{
+	return sz ? (int)((sz - 1) / GRANULE) : 0;
+}
+
+/* carves a new chunk into blocks of the given class and links them to the
+ * free list of that class
+ */
+static bool add_chunk(int cls)
+{
+	size_t bsz = (cls + 1) * GRANULE;
+	int nblocks = CHUNK_SIZE / bsz;
+
+	char *chunk = (char*)malloc(CHUNK_SIZE);
+	if(!chunk) return false;
+
+	for(int i=0; i<nblocks; i++) {
+		FreeBlock *blk = (FreeBlock*)(chunk + i * bsz);
+		blk->next = free_list[cls];
+		free_list[cls] = blk;
+	}
+	return true;
+}
+
+void *pool_alloc(size_t sz)
+{
+	if(sz > POOL_MAX_SIZE) {
+		return ::operator new(sz);
+	}
+
+	int cls = size_class(sz);
+
+	std::lock_guard<std::mutex> lock(pool_mutex);
+	if(!free_list[cls] && !add_chunk(cls)) {
+		throw std::bad_alloc();
+	}
+	FreeBlock *blk = free_list[cls];
+	free_list[cls] = blk->next;
+	return blk;
+}
+
+void pool_free(void *ptr, size_t sz)
+{
+	if(!ptr) return;
+
+	if(sz > POOL_MAX_SIZE) {
+		::operator delete(ptr);
+		return;
+	}
+
+	int cls = size_class(sz);
+	FreeBlock *blk = (FreeBlock*)ptr;
+
+	std::lock_guard<std::mutex> lock(pool_mutex);
+	blk->next = free_list[cls];
+	free_list[cls] = blk;
+}
+
+}	// namespace vrtk
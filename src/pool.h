@@ -0,0 +1,97 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef POOL_H_
+#define POOL_H_
+
+#include <stddef.h>
+#include <vector>
+
+namespace vrtk {
+
+/* Size-class object pool. Small objects are carved out of large chunks, and
+ * freed ones are kept in a free list per size class for reuse, so creating
+ * and destroying lots of widgets doesn't fragment the heap. Objects larger
+ * than POOL_MAX_SIZE go straight to the system allocator. Thread-safe.
+ */
+#define POOL_MAX_SIZE	1024
+
+void *pool_alloc(size_t sz);
+void pool_free(void *ptr, size_t sz);
+
+/* derive internal classes from PoolObject to allocate them from the pool */
+class PoolObject {
+public:
+	static void *operator new(size_t sz) { return pool_alloc(sz); }
+	static void operator delete(void *ptr, size_t sz) { pool_free(ptr, sz); }
+};
+
+
+/* Maps generation-checked handles to objects. Looking up a handle of a
+ * removed object fails, even if its slot has been reused since.
+ */
+template <typename T>
+class HandleTable {
+private:
+	struct Entry {
+		T *obj;
+		unsigned int gen;
+		int next_free;
+	};
+	std::vector<Entry> entries;
+	int free_head;
+
+public:
+	HandleTable() : free_head(-1) {}
+
+	void add(T *obj, unsigned int *idx, unsigned int *gen)
+	{
+		int i;
+		if(free_head >= 0) {
+			i = free_head;
+			free_head = entries[i].next_free;
+		} else {
+			i = (int)entries.size();
+			Entry ent;
+			ent.gen = 1;
+			entries.push_back(ent);
+		}
+		entries[i].obj = obj;
+		*idx = i;
+		*gen = entries[i].gen;
+	}
+
+	void remove(unsigned int idx)
+	{
+		entries[idx].obj = 0;
+		entries[idx].gen++;
+		entries[idx].next_free = free_head;
+		free_head = idx;
+	}
+
+	T *lookup(unsigned int idx, unsigned int gen) const
+	{
+		if(idx >= entries.size() || entries[idx].gen != gen) {
+			return 0;
+		}
+		return entries[idx].obj;
+	}
+};
+
+}	// namespace vrtk
+
+#endif	// POOL_H_
@@ -0,0 +1,173 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <math.h>
+#include "pose_predict.h"
+
+namespace vrtk {
+
+// samples further apart than this don't make a history, it starts over
+#define MAX_GAP		100000
+
+static Vec3 rotate(const Vec3 &v, const Vec3 &axis_angle, float t);
+static Vec3 dir_rotation(const Vec3 &a, const Vec3 &b);
+static Vec3 quat_rotation(const Quat &a, const Quat &b);
+
+PosePredictor::PosePredictor()
+{
+	horizon = 50000;
+	smoothing = 0.5f;
+	reset();
+}
+
+void PosePredictor::reset()
+{
+	num_samples = 0;
+	last = -1;
+	vel = dir_angvel = angvel = Vec3(0, 0, 0);
+}
+
+void PosePredictor::add_sample(long long time, const Vec3 &pos, const Vec3 &dir, const Quat &rot)
+{
+	if(num_samples > 0) {
+		long long dt = time - hist[last].time;
+		if(dt <= 0) return;
+		if(dt > MAX_GAP) {
+			reset();
+		}
+	}
+
+	last = (last + 1) % PRED_HISTORY;
+	hist[last].time = time;
+	hist[last].pos = pos;
+	hist[last].dir = dir;
+	hist[last].rot = rot;
+	if(num_samples < PRED_HISTORY) {
+		num_samples++;
+	}
+	if(num_samples < 2) return;
+
+	// measured from the oldest sample kept, to the new one
+	const Sample *first = hist + (last + PRED_HISTORY - num_samples + 1) % PRED_HISTORY;
+	float dt = (time - first->time) / 1000000.0f;
+
+	Vec3 meas_vel = (pos - first->pos) / dt;
+	Vec3 meas_dir_angvel = dir_rotation(first->dir, dir) / dt;
+	Vec3 meas_angvel = quat_rotation(first->rot, rot) / dt;
+
+	if(num_samples == 2) {
+		vel = meas_vel;
+		dir_angvel = meas_dir_angvel;
+		angvel = meas_angvel;
+	} else {
+		float s = smoothing;
+		vel = vel * s + meas_vel * (1.0f - s);
+		dir_angvel = dir_angvel * s + meas_dir_angvel * (1.0f - s);
+		angvel = angvel * s + meas_angvel * (1.0f - s);
+	}
+}
+
+void PosePredictor::predict(long long tm, Vec3 *pos, Vec3 *dir, Quat *rot) const
+{
+	if(num_samples <= 0) return;
+
+	const Sample *s = hist + last;
+	*pos = s->pos;
+	*dir = s->dir;
+	*rot = s->rot;
+	if(num_samples < 2) return;
+
+	long long dt_usec = tm - s->time;
+	if(dt_usec <= 0) return;
+	if(dt_usec > horizon) {
+		dt_usec = horizon;
+	}
+	float dt = dt_usec / 1000000.0f;
+
+	*pos = s->pos + vel * dt;
+	*dir = rotate(s->dir, dir_angvel, dt);
+
+	float angle = length(angvel) * dt;
+	if(angle > 1e-6f) {
+		*rot = normalize(Quat(angvel / length(angvel), angle) * s->rot);
+	}
+}
+
+void PosePredictor::set_horizon(long usec)
+{
+	horizon = usec;
+}
+
+long PosePredictor::get_horizon() const
+{
+	return horizon;
+}
+
+void PosePredictor::set_smoothing(float s)
+{
+	smoothing = s < 0.0f ? 0.0f : (s > 0.99f ? 0.99f : s);
+}
+
+float PosePredictor::get_smoothing() const
+{
+	return smoothing;
+}
+
+/* rotates v around the axis of axis_angle, by its length times t (Rodrigues'
+ * rotation formula)
+ */
+static Vec3 rotate(const Vec3 &v, const Vec3 &axis_angle, float t)
+{
+	float len = length(axis_angle);
+	float angle = len * t;
+	if(angle < 1e-6f) return v;
+
+	Vec3 k = axis_angle / len;
+	float cs = cos(angle);
+	float sn = sin(angle);
+	return v * cs + cross(k, v) * sn + k * (dot(k, v) * (1.0f - cs));
+}
+
+// rotation taking direction a to b, as an axis scaled by the angle
+static Vec3 dir_rotation(const Vec3 &a, const Vec3 &b)
+{
+	Vec3 na = normalize(a);
+	Vec3 nb = normalize(b);
+	Vec3 axis = cross(na, nb);
+	float sn = length(axis);
+	if(sn < 1e-7f) {
+		return Vec3(0, 0, 0);
+	}
+	return axis * (atan2(sn, dot(na, nb)) / sn);
+}
+
+// rotation taking orientation a to b, the same way
+static Vec3 quat_rotation(const Quat &a, const Quat &b)
+{
+	Quat d = b * a.conjugate();
+	if(d.w < 0.0f) {
+		d = d * -1.0f;	// the short way around
+	}
+	Vec3 axis = Vec3(d.x, d.y, d.z);
+	float sn = length(axis);
+	if(sn < 1e-7f) {
+		return Vec3(0, 0, 0);
+	}
+	return axis * (2.0f * atan2(sn, d.w) / sn);
+}
+
+}	// namespace vrtk
@@ -0,0 +1,73 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef POSE_PREDICT_H_
+#define POSE_PREDICT_H_
+
+#include <gmath/gmath.h>
+
+namespace vrtk {
+
+#define PRED_HISTORY	8
+
+/* extrapolates a tracked pose (position, pointing direction and orientation)
+ * to a time in the near future, from its linear and angular velocity. Those
+ * are measured across the last few samples, instead of the last two, to be
+ * less sensitive to tracking jitter, and then smoothed exponentially.
+ */
+class PosePredictor {
+private:
+	struct Sample {
+		long long time;	// usec
+		Vec3 pos, dir;
+		Quat rot;
+	} hist[PRED_HISTORY];
+	int num_samples, last;
+
+	Vec3 vel;			// units per second
+	Vec3 dir_angvel;	// rotation of dir, axis scaled by radians per second
+	Vec3 angvel;		// rotation of rot, same
+
+	long horizon;		// usec
+	float smoothing;
+
+public:
+	PosePredictor();
+
+	void reset();	// forgets the history
+
+	// samples must be in time order; out of order ones are ignored
+	void add_sample(long long time, const Vec3 &pos, const Vec3 &dir, const Quat &rot);
+
+	/* predicts the pose at time tm. Extrapolation goes at most the horizon
+	 * past the last sample, and with less than two samples there is none.
+	 */
+	void predict(long long tm, Vec3 *pos, Vec3 *dir, Quat *rot) const;
+
+	/* horizon: how far past the last sample to extrapolate at most (default
+	 * 50ms). smoothing: weight of the old velocity estimates against each
+	 * new measurement, in [0, 1) (default 0.5).
+	 */
+	void set_horizon(long usec);
+	long get_horizon() const;
+	void set_smoothing(float s);
+	float get_smoothing() const;
+};
+
+}	// namespace vrtk
+
+#endif	// POSE_PREDICT_H_
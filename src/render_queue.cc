@@ -0,0 +1,325 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <string.h>
+#include "opengl.h"
+#include "render_queue.h"
+#include "glstate.h"
+#include "widget.h"
+#include "shape.h"
+#include "mesh.h"
+
+namespace vrtk {
+
+uint64_t draw_key(unsigned int sdr, const Mesh *mesh, unsigned int color)
+{
+	uint64_t key = (uint64_t)(sdr & 0xfff) << 52;
+	if(mesh) {
+		key |= (uint64_t)(mesh->get_id() & 0xfffff) << 32;
+	}
+	return key | color;
+}
+
+static inline unsigned int pack_elem(float x)
+{
+	if(x <= 0.0f) return 0;
+	if(x >= 1.0f) return 255;
+	return (unsigned int)(x * 255.0f + 0.5f);
+}
+
+unsigned int pack_color(const Vec4 &color)
+{
+	return (pack_elem(color.x) << 24) | (pack_elem(color.y) << 16) |
+		(pack_elem(color.z) << 8) | pack_elem(color.w);
+}
+
+void radix_sort(SortEntry *arr, SortEntry *tmp, int count)
+{
+	if(count < 2) return;
+
+	// histograms of all 8 digits in one pass
+	unsigned int hist[8][256];
+	memset(hist, 0, sizeof hist);
+
+	for(int i=0; i<count; i++) {
+		uint64_t key = arr[i].key;
+		for(int j=0; j<8; j++) {
+			hist[j][(key >> (j * 8)) & 0xff]++;
+		}
+	}
+
+	SortEntry *src = arr;
+	SortEntry *dst = tmp;
+
+	for(int j=0; j<8; j++) {
+		unsigned int *h = hist[j];
+
+		// all keys have the same value for this digit, nothing to do
+		if(h[(src[0].key >> (j * 8)) & 0xff] == (unsigned int)count) {
+			continue;
+		}
+
+		unsigned int offs = 0;
+		for(int k=0; k<256; k++) {
+			unsigned int n = h[k];
+			h[k] = offs;
+			offs += n;
+		}
+
+		for(int i=0; i<count; i++) {
+			dst[h[(src[i].key >> (j * 8)) & 0xff]++] = src[i];
+		}
+
+		SortEntry *swp = src;
+		src = dst;
+		dst = swp;
+	}
+
+	if(src != arr) {
+		memcpy(arr, src, count * sizeof *arr);
+	}
+}
+
+void RenderQueue::clear()
+{
+	items.clear();
+	order.clear();
+}
+
+bool init_draw_item(DrawItem *item, const Widget *w, float fade)
+{
+	Shape *shape = w->get_shape();
+	bool custom = w->has_draw_func();
+	const Mesh *mesh = 0;
+
+	if(!custom) {
+		if(!shape) return false;	// nothing to draw
+
+		if(!(mesh = shape->get_mesh())) {
+			custom = true;
+		}
+	}
+
+	item->widget = w;
+	item->mesh = mesh;
+	item->xform = &w->get_world_xform();
+	item->sdr = w->get_shader();
+	Vec4 color = w->get_color();
+	color.w *= fade;
+	item->color = pack_color(color);
+	item->key = draw_key(item->sdr, mesh, item->color);
+	item->impostor = false;
+	return true;
+}
+
+void RenderQueue::add(const Widget *w)
+{
+	DrawItem item;
+	if(init_draw_item(&item, w)) {
+		items.push_back(item);
+	}
+}
+
+void RenderQueue::resize(int num_slots)
+{
+	DrawItem empty;
+	memset(&empty, 0, sizeof empty);
+	items.resize(num_slots, empty);
+}
+
+DrawItem *RenderQueue::get_slot(int idx)
+{
+	return &items[idx];
+}
+
+void RenderQueue::remove_slot(int idx)
+{
+	items[idx] = items.back();
+	items.pop_back();
+}
+
+void RenderQueue::sort()
+{
+	order.clear();
+	blend_order.clear();
+
+	int num_slots = items.size();
+	for(int i=0; i<num_slots; i++) {
+		if(!items[i].widget) continue;
+
+		SortEntry ent;
+		ent.key = items[i].key;
+		ent.idx = i;
+		if(is_translucent(&items[i])) {
+			blend_order.push_back(ent);	// keyed by sort_depth
+		} else {
+			order.push_back(ent);
+		}
+	}
+
+	int count = order.size();
+	if(count) {
+		tmp.resize(count);
+		radix_sort(&order[0], &tmp[0], count);
+	}
+}
+
+/* positive floats sort the same as their bit patterns, and inverting those
+ * sorts them in descending order: the furthest first
+ */
+static inline uint64_t depth_key(float dist_sq)
+{
+	uint32_t bits;
+	memcpy(&bits, &dist_sq, sizeof bits);
+	return ~bits;
+}
+
+void RenderQueue::sort_depth(const Vec3 &viewer)
+{
+	int count = blend_order.size();
+	if(!count) return;
+
+	bool sorted = true;
+	for(int i=0; i<count; i++) {
+		const Mat4 &xform = *items[blend_order[i].idx].xform;
+		Vec3 pos = Vec3(xform[3][0], xform[3][1], xform[3][2]);
+
+		uint64_t key = depth_key(distance_sq(pos, viewer));
+		if(i > 0 && key < blend_order[i - 1].key) {
+			sorted = false;
+		}
+		blend_order[i].key = key;
+	}
+
+	// usually nothing moved enough to change the order since the last frame
+	if(!sorted) {
+		tmp.resize(count);
+		radix_sort(&blend_order[0], &tmp[0], count);
+	}
+}
+
+void RenderQueue::submit(int instances, bool skip_impostors) const
+{
+	draw_items(order, instances, skip_impostors);
+}
+
+void RenderQueue::submit_translucent(int instances) const
+{
+	if(blend_order.empty()) return;
+
+#ifndef GL_ES_VERSION_2_0
+	glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+#endif
+	glEnable(GL_BLEND);
+	/* alpha is accumulated premultiplied, so that when drawing into a layer
+	 * cache, the layer ends up premultiplied as a whole
+	 */
+	glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	glDepthMask(0);
+
+	draw_items(blend_order, instances, false);
+
+#ifndef GL_ES_VERSION_2_0
+	glPopAttrib();
+#else
+	glDepthMask(1);
+	glDisable(GL_BLEND);
+#endif
+}
+
+void RenderQueue::draw_items(const std::vector<SortEntry> &ord, int instances, bool skip_impostors) const
+{
+	int count = ord.size();
+	if(!count) return;
+
+	unsigned int host_sdr = gl_current_program();
+	const Mesh *cur_mesh = 0;
+	unsigned int cur_color = 0;
+	bool color_valid = false;
+
+#ifndef GL_ES_VERSION_2_0
+	glPushAttrib(GL_CURRENT_BIT);
+	glMatrixMode(GL_MODELVIEW);
+#endif
+
+	for(int i=0; i<count; i++) {
+		const DrawItem &item = items[ord[i].idx];
+		if(skip_impostors && item.impostor) continue;
+
+		unsigned int sdr = item.sdr ? item.sdr : host_sdr;
+		if(sdr != gl_current_program()) {
+			gl_use_program(sdr);
+			// the attribute setup of a bound mesh depends on the program
+			cur_mesh = 0;
+		}
+
+#ifndef GL_ES_VERSION_2_0
+		if(!color_valid || item.color != cur_color) {
+			unsigned int c = item.color;
+			glColor4ub(c >> 24, (c >> 16) & 0xff, (c >> 8) & 0xff, c & 0xff);
+			cur_color = c;
+			color_valid = true;
+		}
+
+		glPushMatrix();
+		glMultMatrixf((*item.xform)[0]);
+#endif
+
+		if(item.mesh) {
+			/* no need to unbind the previous mesh first, bind only changes
+			 * the array state which differs between the two
+			 */
+			if(item.mesh != cur_mesh) {
+				cur_mesh = item.mesh->bind() ? item.mesh : 0;
+			}
+			if(cur_mesh) {
+				cur_mesh->draw_bound(instances);
+			}
+		} else {
+			gl_reset_arrays();
+			cur_mesh = 0;
+			item.widget->draw();
+			color_valid = false;	// can't know what it did
+		}
+
+#ifndef GL_ES_VERSION_2_0
+		glPopMatrix();
+#endif
+	}
+
+	gl_reset_arrays();
+	gl_use_program(host_sdr);
+#ifndef GL_ES_VERSION_2_0
+	glPopAttrib();
+#endif
+}
+
+int RenderQueue::size() const
+{
+	return (int)(order.size() + blend_order.size());
+}
+
+const DrawItem &RenderQueue::get_item(int idx) const
+{
+	int num_opaque = order.size();
+	if(idx < num_opaque) {
+		return items[order[idx].idx];
+	}
+	return items[blend_order[idx - num_opaque].idx];
+}
+
+}	// namespace vrtk
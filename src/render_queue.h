@@ -0,0 +1,117 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef RENDER_QUEUE_H_
+#define RENDER_QUEUE_H_
+
+#include <stdint.h>
+#include <vector>
+#include <gmath/gmath.h>
+
+namespace vrtk {
+
+class Widget;
+class Mesh;
+
+/* sort key layout, most significant first:
+ *   12 bits shader program, 20 bits mesh id, 32 bits RGBA8 color
+ * so that sorting groups draws by program, then by mesh, then by color.
+ * Custom draws have mesh id 0, and go first in their program group.
+ */
+uint64_t draw_key(unsigned int sdr, const Mesh *mesh, unsigned int color);
+unsigned int pack_color(const Vec4 &color);
+
+struct DrawItem {
+	uint64_t key;
+	const Widget *widget;
+	const Mesh *mesh;	// 0 for custom draws, which call Widget::draw
+	const Mat4 *xform;	// world transformation
+	unsigned int sdr;	// 0: the program bound by the host
+	unsigned int color;	// packed RGBA8
+	bool impostor;		// capsule drawn by CapsImpostors, when it can be
+};
+
+/* fills in a draw item for a widget, with the alpha of its color scaled by
+ * fade. Returns false if there's nothing to draw. Makes no GL calls.
+ */
+bool init_draw_item(DrawItem *item, const Widget *w, float fade = 1.0f);
+
+inline bool is_translucent(const DrawItem *item)
+{
+	return (item->color & 0xff) != 0xff;
+}
+
+struct SortEntry {
+	uint64_t key;
+	int idx;
+};
+
+/* LSD radix sort on 8-bit digits, skipping digits all keys share.
+ * tmp must have room for count entries. Stable.
+ */
+void radix_sort(SortEntry *arr, SortEntry *tmp, int count);
+
+/* Items live in slots, which persist until cleared, so that a retained list
+ * can be updated in place. Slots with a null widget are empty, and skipped.
+ *
+ * Opaque items are sorted by state, and drawn first. Translucent items are
+ * sorted back to front by distance from the viewer, and drawn after, blended.
+ */
+class RenderQueue {
+private:
+	std::vector<DrawItem> items;
+	std::vector<SortEntry> order, blend_order, tmp;
+
+	void draw_items(const std::vector<SortEntry> &ord, int instances, bool skip_impostors) const;
+
+public:
+	void clear();
+	void add(const Widget *w);
+
+	// slot access; new slots are empty
+	void resize(int num_slots);
+	DrawItem *get_slot(int idx);
+	// constant time, the last slot takes the place of the removed one
+	void remove_slot(int idx);
+
+	// sorts the non-empty slots, must be called again after changing any
+	void sort();
+	/* sorts the translucent items by depth. Needed every time the viewer or
+	 * any of them moves, but the sort is skipped if the order still holds.
+	 */
+	void sort_depth(const Vec3 &viewer);
+
+	/* draws the opaque items in sorted order, skipping redundant program and
+	 * mesh binds, and vertex attribute setup between draws of the same mesh.
+	 * Meshes are drawn with the given number of instances, custom draws
+	 * are called once regardless. Impostor items are custom draws, unless
+	 * skipped, for drawing them as impostors instead.
+	 */
+	void submit(int instances = 1, bool skip_impostors = false) const;
+	/* draws the translucent items back to front, with blending enabled and
+	 * without depth writes
+	 */
+	void submit_translucent(int instances = 1) const;
+
+	int size() const;	// number of items sorted
+	// items in drawing order, opaque first, after sort
+	const DrawItem &get_item(int idx) const;
+};
+
+}	// namespace vrtk
+
+#endif	// RENDER_QUEUE_H_
@@ -16,18 +16,22 @@ You should have received a copy of the GNU Lesser General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "shape.h"
+#include "pool.h"
+#include "widget_priv.h"
 
 namespace vrtk {
 
-class ShapePriv {
+class ShapePriv : public PoolObject {
 public:
 	Widget *widget;
+	unsigned int rev;
 };
 
 Shape::Shape()
 {
 	priv = new ShapePriv;
 	priv->widget = 0;
+	priv->rev = 0;
 }
 
 Shape::~Shape()
@@ -35,6 +39,16 @@ Shape::~Shape()
 	delete priv;
 }
 
+void *Shape::operator new(size_t sz)
+{
+	return pool_alloc(sz);
+}
+
+void Shape::operator delete(void *ptr, size_t sz)
+{
+	pool_free(ptr, sz);
+}
+
 ShapeType Shape::get_type() const
 {
 	return SHAPE_UNKNOWN;
@@ -50,6 +64,29 @@ Widget *Shape::get_widget() const
 	return priv->widget;
 }
 
+unsigned int Shape::get_revision() const
+{
+	return priv->rev;
+}
+
+void Shape::geometry_changed()
+{
+	priv->rev++;
+	if(priv->widget) {
+		mark_draw_dirty(priv->widget);
+	}
+}
+
+bool Shape::get_aabbox(AABox *box) const
+{
+	return false;
+}
+
+const Mesh *Shape::get_mesh() const
+{
+	return 0;
+}
+
 void Shape::draw() const
 {
 }
@@ -18,12 +18,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef VRTK_SHAPE_H_
 #define VRTK_SHAPE_H_
 
+#include <stddef.h>
 #include <gmath/gmath.h>
 
 namespace vrtk {
 
 class Widget;
 class Sphere;
+class AABox;
+class Mesh;
 class HitPoint;
 class ShapePriv;
 
@@ -37,19 +40,40 @@ class Shape {
 private:
 	ShapePriv *priv;
 
+protected:
+	/* must be called by subclasses whenever the geometry changes, to let
+	 * anyone caching derived data (like the widget bounds) know about it.
+	 */
+	void geometry_changed();
+
 public:
 	Shape();
 	virtual ~Shape();
 
+	// shapes are allocated from the vrtk object pools
+	static void *operator new(size_t sz);
+	static void operator delete(void *ptr, size_t sz);
+
 	virtual ShapeType get_type() const;
 
 	virtual void set_widget(Widget *w);
 	virtual Widget *get_widget() const;
 
+	/* incremented every time the geometry changes */
+	unsigned int get_revision() const;
+
+	/* local-space bounding box, returns false if the shape can't be bounded */
+	virtual bool get_aabbox(AABox *box) const;
+
 	virtual bool contains(const Vec3 &pt) const = 0;
 	virtual bool intersect(const Sphere &sph, HitPoint *hit = 0) const = 0;
 	virtual bool intersect(const Ray &ray, HitPoint *hit = 0) const = 0;
 
+	/* mesh used to draw the shape, if there is one. Shapes with a mesh are
+	 * batched by the WidgetGroup render queue, others are drawn with draw().
+	 */
+	virtual const Mesh *get_mesh() const;
+
 	virtual void draw() const;
 };
 
@@ -15,27 +15,32 @@ GNU Lesser General Public License for more details.
 You should have received a copy of the GNU Lesser General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
+#include <float.h>
 #include <gmath/gmath.h>
 #include "shape_caps.h"
 #include "geom.h"
 #include "mesh.h"
 #include "meshgen.h"
+#include "pool.h"
+#include "stats_priv.h"
 
 namespace vrtk {
 
-class ShapeCapsPriv {
+class ShapeCapsPriv : public PoolObject {
 public:
 	Vec3 end[2];
 	float rad;
 
 	Vec3 axis;	// end[1] - end[0]
 	float axis_len;
+	AABox bbox;
 	bool derived_valid;
 
 	Mesh *mesh;	// only generated if it's needed
 };
 
 static void update_derived(ShapeCapsPriv *priv);
+static void update_mesh(ShapeCapsPriv *priv);
 
 ShapeCaps::ShapeCaps()
 {
@@ -68,17 +73,21 @@ void ShapeCaps::set_capsule(const Vec3 &a, const Vec3 &b, float rad)
 	priv->end[1] = b;
 	priv->rad = rad;
 	priv->derived_valid = false;
+	geometry_changed();
 }
 
 void ShapeCaps::set_end(int idx, const Vec3 &v)
 {
 	priv->end[idx] = v;
 	priv->derived_valid = false;
+	geometry_changed();
 }
 
 void ShapeCaps::set_radius(float r)
 {
 	priv->rad = r;
+	priv->derived_valid = false;
+	geometry_changed();
 }
 
 const Vec3 &ShapeCaps::get_end(int idx) const
@@ -97,8 +106,17 @@ const Vec3 &ShapeCaps::get_axis() const
 	return priv->axis;
 }
 
+bool ShapeCaps::get_aabbox(AABox *box) const
+{
+	update_derived(priv);
+	*box = priv->bbox;
+	return true;
+}
+
 bool ShapeCaps::contains(const Vec3 &pt) const
 {
+	update_derived(priv);
+
 	float radsq = priv->rad * priv->rad;
 	float t = proj_point_line_param(pt, Ray(priv->end[0], priv->axis));
 	if(t < 0.0) {
@@ -117,6 +135,8 @@ bool ShapeCaps::contains(const Vec3 &pt) const
  */
 bool ShapeCaps::intersect(const Sphere &sph, HitPoint *hit) const
 {
+	update_derived(priv);
+
 	float rad = priv->rad + sph.rad;
 	float radsq = rad * rad;
 	float t = proj_point_line_param(sph.pos, Ray(priv->end[0], priv->axis));
@@ -131,50 +151,43 @@ bool ShapeCaps::intersect(const Sphere &sph, HitPoint *hit) const
 }
 
 
-/* XXX doesn't always return the nearest intersection, but for our use it
- * doesn't matter
- */
+// nearest of the hits with the end spheres and the cylinder between them
 bool ShapeCaps::intersect(const Ray &ray, HitPoint *hit) const
 {
+	HitPoint nearest, tmp;
+	nearest.t = FLT_MAX;
+
 	Sphere sph0 = Sphere(priv->end[0], priv->rad);
-	if(vrtk::intersect(ray, sph0, hit)) {
-		return true;
+	if(vrtk::intersect(ray, sph0, &tmp) && tmp.t < nearest.t) {
+		nearest = tmp;
 	}
-
 	Sphere sph1 = Sphere(priv->end[1], priv->rad);
-	if(vrtk::intersect(ray, sph1, hit)) {
-		return true;
+	if(vrtk::intersect(ray, sph1, &tmp) && tmp.t < nearest.t) {
+		nearest = tmp;
 	}
-
 	Cylinder cyl = Cylinder(priv->end[0], priv->end[1], priv->rad);
-	return vrtk::intersect(ray, cyl, hit);
+	if(vrtk::intersect(ray, cyl, &tmp) && tmp.t < nearest.t) {
+		nearest = tmp;
+	}
+
+	if(nearest.t == FLT_MAX) {
+		return false;
+	}
+	if(hit) {
+		*hit = nearest;
+	}
+	return true;
 }
 
-void ShapeCaps::draw() const
+const Mesh *ShapeCaps::get_mesh() const
 {
-	if(!priv->mesh) {
-		update_derived(priv);
-
-		Vec3 dir = priv->axis;
-		float dirlen = priv->axis_len;
-		if(dirlen != 0.0) {
-			dir /= dirlen;
-		}
-
-		priv->mesh = new Mesh;
-		gen_capsule(priv->mesh, priv->rad, dirlen, 16, 16);
-
-		Vec3 vk = Vec3(0, 0, 1);
-		if(1.0 - fabs(dot(dir, vk)) < 1e-3) {
-			vk = Vec3(0, 1, 0);
-		}
-
-		Vec3 right = normalize(cross(dir, vk));
-		vk = cross(right, dir);
+	update_mesh(priv);
+	return priv->mesh;
+}
 
-		Mat4 xform = Mat4(right, dir, vk);
-		priv->mesh->apply_xform(xform);
-	}
+void ShapeCaps::draw() const
+{
+	update_mesh(priv);
 	priv->mesh->draw();
 }
 
@@ -184,9 +197,48 @@ static void update_derived(ShapeCapsPriv *priv)
 
 	priv->axis = priv->end[1] - priv->end[0];
 	priv->axis_len = length(priv->axis);
+
+	Vec3 rvec = Vec3(priv->rad, priv->rad, priv->rad);
+	for(int i=0; i<3; i++) {
+		float a = priv->end[0][i];
+		float b = priv->end[1][i];
+		priv->bbox.min[i] = (a < b ? a : b) - rvec[i];
+		priv->bbox.max[i] = (a > b ? a : b) + rvec[i];
+	}
 	priv->derived_valid = true;
 
 	delete priv->mesh;
+	priv->mesh = 0;
+}
+
+static void update_mesh(ShapeCapsPriv *priv)
+{
+	update_derived(priv);	// drops the mesh if the capsule changed
+	if(priv->mesh) return;
+
+	Vec3 dir = priv->axis;
+	float dirlen = priv->axis_len;
+	if(dirlen != 0.0) {
+		dir /= dirlen;
+	}
+
+	priv->mesh = new Mesh;
+	gen_capsule(priv->mesh, priv->rad, dirlen, 16, 16);
+	STAT_ADD(STAT_MESHES_GEN, 1);
+
+	Vec3 vk = Vec3(0, 0, 1);
+	if(1.0 - fabs(dot(dir, vk)) < 1e-3) {
+		vk = Vec3(0, 1, 0);
+	}
+
+	Vec3 right = normalize(cross(dir, vk));
+	vk = cross(right, dir);
+
+	// gen_capsule centers the mesh around the origin
+	Mat4 xform;
+	xform.translation((priv->end[0] + priv->end[1]) * 0.5f);
+	xform *= Mat4(right, dir, vk);
+	priv->mesh->apply_xform(xform);
 }
 
 }	// namespace vrtk
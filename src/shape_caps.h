@@ -44,10 +44,13 @@ public:
 
 	const Vec3 &get_axis() const;
 
+	bool get_aabbox(AABox *box) const;
+
 	bool contains(const Vec3 &pt) const;
 	bool intersect(const Sphere &sph, HitPoint *hit = 0) const;
 	bool intersect(const Ray &ray, HitPoint *hit = 0) const;
 
+	const Mesh *get_mesh() const;
 	void draw() const;
 };
 
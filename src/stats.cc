@@ -0,0 +1,144 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "stats_priv.h"
+#include "anim_store.h"
+
+namespace vrtk {
+
+static const char *names[] = {
+	"draw_calls",
+	"triangles",
+	"uploads",
+	"upload_bytes",
+	"rays",
+	"shapes_tested",
+	"tris_tested",
+	"meshes_gen",
+	"active_anims"
+};
+
+#ifndef VRTK_NO_STATS
+std::atomic<long> stats_count[NUM_STATS];
+
+// ring buffer of completed frames, hist_head is the next to write
+static long hist[STATS_HISTORY][NUM_STATS];
+static int hist_head, hist_count;
+#endif
+
+bool stats_enabled()
+{
+#ifndef VRTK_NO_STATS
+	return true;
+#else
+	return false;
+#endif
+}
+
+const char *stats_name(int stat)
+{
+	if(stat < 0 || stat >= NUM_STATS) {
+		return 0;
+	}
+	return names[stat];
+}
+
+long stats_current(int stat)
+{
+#ifndef VRTK_NO_STATS
+	if(stat >= 0 && stat < NUM_STATS) {
+		return stats_count[stat].load(std::memory_order_relaxed);
+	}
+#endif
+	return 0;
+}
+
+long stats_frame(int stat, int age)
+{
+#ifndef VRTK_NO_STATS
+	if(stat >= 0 && stat < NUM_STATS && age >= 0 && age < hist_count) {
+		int idx = (hist_head + STATS_HISTORY - 1 - age) % STATS_HISTORY;
+		return hist[idx][stat];
+	}
+#endif
+	return 0;
+}
+
+int stats_num_frames()
+{
+#ifndef VRTK_NO_STATS
+	return hist_count;
+#else
+	return 0;
+#endif
+}
+
+void stats_clear()
+{
+#ifndef VRTK_NO_STATS
+	for(int i=0; i<NUM_STATS; i++) {
+		stats_count[i].store(0, std::memory_order_relaxed);
+	}
+	hist_head = hist_count = 0;
+#endif
+}
+
+void stats_end_frame()
+{
+#ifndef VRTK_NO_STATS
+	// sampled rather than counted, as of the end of the frame
+	stats_count[STAT_ACTIVE_ANIMS].store(get_anim_store()->num_active(), std::memory_order_relaxed);
+
+	long *frame = hist[hist_head];
+	for(int i=0; i<NUM_STATS; i++) {
+		frame[i] = stats_count[i].exchange(0, std::memory_order_relaxed);
+	}
+	hist_head = (hist_head + 1) % STATS_HISTORY;
+	if(hist_count < STATS_HISTORY) {
+		hist_count++;
+	}
+#endif
+}
+
+bool stats_dump_json(const char *fname)
+{
+	FILE *fp = fopen(fname, "w");
+	if(!fp) {
+		return false;
+	}
+	bool res = stats_dump_json(fp);
+	fclose(fp);
+	return res;
+}
+
+bool stats_dump_json(FILE *fp)
+{
+	int num_frames = stats_num_frames();
+
+	fprintf(fp, "{\n\t\"frames\": %d", num_frames);
+	for(int i=0; i<NUM_STATS; i++) {
+		fprintf(fp, ",\n\t\"%s\": [", names[i]);
+		for(int j=0; j<num_frames; j++) {
+			fprintf(fp, j ? ", %ld" : "%ld", stats_frame(i, num_frames - 1 - j));
+		}
+		fputc(']', fp);
+	}
+	fputs("\n}\n", fp);
+	return !ferror(fp);
+}
+
+}	// namespace vrtk
@@ -0,0 +1,51 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef STATS_PRIV_H_
+#define STATS_PRIV_H_
+
+/* counting for the per-frame counters of stats.h. Counts may come from any
+ * thread, so hot loops should add up locally, and count once.
+ */
+#include "stats.h"
+
+#ifndef VRTK_NO_STATS
+#include <atomic>
+
+namespace vrtk {
+
+extern std::atomic<long> stats_count[NUM_STATS];
+
+}	// namespace vrtk
+
+#define STAT_ADD(stat, n) \
+	vrtk::stats_count[stat].fetch_add(n, std::memory_order_relaxed)
+
+#else
+
+#define STAT_ADD(stat, n)	((void)0)
+
+#endif	// VRTK_NO_STATS
+
+namespace vrtk {
+
+// called by the frame clock, when it's advanced
+void stats_end_frame();
+
+}	// namespace vrtk
+
+#endif	// STATS_PRIV_H_
@@ -0,0 +1,252 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <vector>
+#include <mutex>
+#include "trace_priv.h"
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#endif
+
+namespace vrtk {
+
+#ifdef VRTK_TRACE
+
+#define BUF_SIZE	65536
+
+struct TraceEvent {
+	const char *name;
+	long long start, end;	// nanoseconds
+};
+
+/* written only by its thread: each event is filled in first, and then
+ * published by the release store to count, so that readers on other threads
+ * only see complete events
+ */
+struct TraceBuffer {
+	long tid;
+	TraceEvent *events;
+	std::atomic<int> count;
+};
+
+std::atomic<bool> trace_active(false);
+
+// the list is locked, but not the buffers. Buffers outlive their threads.
+static std::mutex buf_mutex;
+static std::vector<TraceBuffer*> buffers;
+static thread_local TraceBuffer *thread_buf;
+
+static long get_tid();
+static int get_pid();
+
+static TraceBuffer *new_buffer()
+{
+	TraceBuffer *buf = new TraceBuffer;
+	buf->tid = get_tid();
+	buf->events = new TraceEvent[BUF_SIZE];
+	buf->count.store(0, std::memory_order_relaxed);
+
+	std::lock_guard<std::mutex> lock(buf_mutex);
+	buffers.push_back(buf);
+	return buf;
+}
+
+void trace_add(const char *name, long long start, long long end)
+{
+	TraceBuffer *buf = thread_buf;
+	if(!buf) {
+		buf = thread_buf = new_buffer();
+	}
+
+	int idx = buf->count.load(std::memory_order_relaxed);
+	if(idx >= BUF_SIZE) {
+		return;	// full
+	}
+	TraceEvent *ev = buf->events + idx;
+	ev->name = name;
+	ev->start = start;
+	ev->end = end;
+	buf->count.store(idx + 1, std::memory_order_release);
+}
+
+bool trace_available()
+{
+	return true;
+}
+
+void trace_start()
+{
+	trace_active.store(true, std::memory_order_relaxed);
+}
+
+void trace_stop()
+{
+	trace_active.store(false, std::memory_order_relaxed);
+}
+
+bool trace_is_active()
+{
+	return trace_active.load(std::memory_order_relaxed);
+}
+
+void trace_clear()
+{
+	std::lock_guard<std::mutex> lock(buf_mutex);
+	for(size_t i=0; i<buffers.size(); i++) {
+		buffers[i]->count.store(0, std::memory_order_relaxed);
+	}
+}
+
+int trace_write_events(FILE *fp, int pid)
+{
+	if(pid == -1) {
+		pid = get_pid();
+	}
+
+	std::vector<TraceBuffer*> bufs;
+	{
+		std::lock_guard<std::mutex> lock(buf_mutex);
+		bufs = buffers;
+	}
+
+	int num_written = 0;
+	for(size_t i=0; i<bufs.size(); i++) {
+		TraceBuffer *buf = bufs[i];
+		int count = buf->count.load(std::memory_order_acquire);
+
+		for(int j=0; j<count; j++) {
+			const TraceEvent *ev = buf->events + j;
+			fprintf(fp, "%s{\"name\": \"%s\", \"cat\": \"vrtk\", \"ph\": \"X\", "
+					"\"ts\": %.3f, \"dur\": %.3f, \"pid\": %d, \"tid\": %ld}",
+					num_written ? ",\n" : "", ev->name, ev->start / 1000.0,
+					(ev->end - ev->start) / 1000.0, pid, buf->tid);
+			num_written++;
+		}
+	}
+	return num_written;
+}
+
+bool trace_dump_json(FILE *fp, int pid)
+{
+	fputs("{\"traceEvents\": [\n", fp);
+	trace_write_events(fp, pid);
+	fputs("\n]}\n", fp);
+	return !ferror(fp);
+}
+
+#ifdef WIN32
+long long trace_nsec()
+{
+	static LARGE_INTEGER freq;
+	if(!freq.QuadPart) {
+		QueryPerformanceFrequency(&freq);
+	}
+	LARGE_INTEGER cnt;
+	QueryPerformanceCounter(&cnt);
+	return (long long)((double)cnt.QuadPart / (double)freq.QuadPart * 1e9);
+}
+
+static long get_tid()
+{
+	return (long)GetCurrentThreadId();
+}
+
+static int get_pid()
+{
+	return (int)GetCurrentProcessId();
+}
+#else
+long long trace_nsec()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static long get_tid()
+{
+#if defined(__linux__) && defined(SYS_gettid)
+	return (long)syscall(SYS_gettid);
+#else
+	// no portable system thread id, number them instead
+	static std::atomic<long> next_tid(1);
+	return next_tid.fetch_add(1);
+#endif
+}
+
+static int get_pid()
+{
+	return (int)getpid();
+}
+#endif
+
+#else	// !VRTK_TRACE
+
+bool trace_available()
+{
+	return false;
+}
+
+void trace_start()
+{
+}
+
+void trace_stop()
+{
+}
+
+bool trace_is_active()
+{
+	return false;
+}
+
+void trace_clear()
+{
+}
+
+int trace_write_events(FILE *fp, int pid)
+{
+	return 0;
+}
+
+bool trace_dump_json(FILE *fp, int pid)
+{
+	fputs("{\"traceEvents\": []}\n", fp);
+	return !ferror(fp);
+}
+
+#endif	// VRTK_TRACE
+
+bool trace_dump_json(const char *fname, int pid)
+{
+	FILE *fp = fopen(fname, "w");
+	if(!fp) {
+		return false;
+	}
+	bool res = trace_dump_json(fp, pid);
+	fclose(fp);
+	return res;
+}
+
+}	// namespace vrtk
@@ -0,0 +1,72 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef TRACE_PRIV_H_
+#define TRACE_PRIV_H_
+
+/* scoped trace zones, see trace.h: TRACE_ZONE("name") records the time from
+ * there to the end of the enclosing block. The name must be a string literal.
+ */
+#include "trace.h"
+
+#ifdef VRTK_TRACE
+#include <atomic>
+
+namespace vrtk {
+
+extern std::atomic<bool> trace_active;
+
+long long trace_nsec();
+void trace_add(const char *name, long long start, long long end);
+
+class TraceZone {
+private:
+	const char *name;
+	long long start;	// -1 if tracing was off when the zone started
+
+public:
+	inline TraceZone(const char *name);
+	inline ~TraceZone();
+};
+
+inline TraceZone::TraceZone(const char *name)
+{
+	this->name = name;
+	start = trace_active.load(std::memory_order_relaxed) ? trace_nsec() : -1;
+}
+
+inline TraceZone::~TraceZone()
+{
+	if(start >= 0) {
+		trace_add(name, start, trace_nsec());
+	}
+}
+
+}	// namespace vrtk
+
+#define TRACE_CAT_(a, b)	a##b
+#define TRACE_CAT(a, b)		TRACE_CAT_(a, b)
+#define TRACE_ZONE(name) \
+	vrtk::TraceZone TRACE_CAT(trace_zone_, __LINE__)(name)
+
+#else
+
+#define TRACE_ZONE(name)	((void)0)
+
+#endif	// VRTK_TRACE
+
+#endif	// TRACE_PRIV_H_
@@ -15,96 +15,188 @@ GNU Lesser General Public License for more details.
 You should have received a copy of the GNU Lesser General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
-#include <vector>
-#include <algorithm>
 #include "widget.h"
+#include "widget_priv.h"
+#include "widgetgroup.h"
 #include "shape.h"
 
 namespace vrtk {
 
-class WidgetPriv {
-public:
-	Widget *parent;
-	std::vector<Widget*> children;
-
-	Vec3 pos, scale;
-	Quat rot;
-	Mat4 xform;
-	bool xform_valid;
-
-	Shape *shape;
-
-	void (*draw_func)(const Widget*, void*);
-	void *draw_func_cls;
+static HandleTable<Widget> *get_handles()
+{
+	// never destroyed, like the xform store, for the same reason
+	static HandleTable<Widget> *handles = new HandleTable<Widget>;
+	return handles;
+}
 
-	BoolAnim visible, focused, hover, grabbed, active;
-	Vec3 grab_pos;
-	Quat grab_rot;
-};
+static void anim_changed(BoolAnim *anim, void *cls)
+{
+	mark_draw_dirty((Widget*)cls);
+}
 
 Widget::Widget()
 {
 	priv = new WidgetPriv;
 	priv->parent = 0;
-	priv->scale = Vec3(1, 1, 1);
+	priv->child_idx = -1;
+	priv->group = 0;
+	priv->group_idx = -1;
+	priv->draw_dirty = false;
+	priv->draw_state = DRAW_NONE;
+	priv->fade = 1.0f;
+	priv->pick_dirty = false;
+	get_handles()->add(this, &priv->handle_idx, &priv->handle_gen);
+	priv->xfstore = get_xform_store();
+	priv->xfslot = priv->xfstore->alloc();
 	priv->shape = 0;
+	priv->bbox_valid = false;
+	priv->color = Vec4(1, 1, 1, 1);
+	priv->sdr = 0;
 	priv->draw_func = 0;
 	priv->draw_func_cls = 0;
+	priv->is_static = false;
+	priv->batch_idx = -1;
+
+	priv->visible.set(true);
+	BoolAnim *anims[] = {&priv->visible, &priv->focused, &priv->hover, &priv->grabbed, &priv->active};
+	for(int i=0; i<5; i++) {
+		anims[i]->set_change_callback(anim_changed, this);
+	}
 }
 
 Widget::~Widget()
 {
+	if(priv->group) {
+		priv->group->remove_widget(this);
+	}
+	if(priv->parent) {
+		priv->parent->remove_child(this);
+	}
+	int nchild = priv->children.size();
+	for(int i=0; i<nchild; i++) {
+		Widget *c = priv->children[i];
+		c->priv->parent = 0;
+		c->priv->child_idx = -1;
+		priv->xfstore->set_parent(c->priv->xfslot, -1);
+		c->invalidate_world_xform();
+	}
+
+	priv->xfstore->free(priv->xfslot);
+	get_handles()->remove(priv->handle_idx);
 	delete priv;
 }
 
+void *Widget::operator new(size_t sz)
+{
+	return pool_alloc(sz);
+}
+
+void Widget::operator delete(void *ptr, size_t sz)
+{
+	pool_free(ptr, sz);
+}
+
+WidgetPriv *widget_priv(const Widget *w)
+{
+	return w->priv;
+}
+
+WidgetHandle Widget::get_handle() const
+{
+	WidgetHandle h;
+	h.idx = priv->handle_idx;
+	h.gen = priv->handle_gen;
+	return h;
+}
+
+Widget *Widget::from_handle(WidgetHandle h)
+{
+	return get_handles()->lookup(h.idx, h.gen);
+}
+
 
 void Widget::set_position(const Vec3 &pos)
 {
-	priv->pos = pos;
-	priv->xform_valid = false;
+	priv->xfstore->set_pos(priv->xfslot, pos);
+	invalidate_xform();
 }
 
 const Vec3 &Widget::get_position() const
 {
-	return priv->pos;
+	return priv->xfstore->get_pos(priv->xfslot);
 }
 
 void Widget::set_rotation(const Quat &rot)
 {
-	priv->rot = rot;
-	priv->xform_valid = false;
+	priv->xfstore->set_rot(priv->xfslot, rot);
+	invalidate_xform();
 }
 
 const Quat &Widget::get_rotation() const
 {
-	return priv->rot;
+	return priv->xfstore->get_rot(priv->xfslot);
 }
 
 void Widget::set_scaling(const Vec3 &scale)
 {
-	priv->scale = scale;
-	priv->xform_valid = false;
+	priv->xfstore->set_scale(priv->xfslot, scale);
+	invalidate_xform();
 }
 
 void Widget::set_scaling(float s)
 {
-	priv->scale = Vec3(s, s, s);
-	priv->xform_valid = false;
+	priv->xfstore->set_scale(priv->xfslot, Vec3(s, s, s));
+	invalidate_xform();
 }
 
 const Vec3 &Widget::get_scaling() const
 {
-	return priv->scale;
+	return priv->xfstore->get_scale(priv->xfslot);
 }
 
 const Mat4 &Widget::get_xform() const
 {
-	if(!priv->xform_valid) {
-		priv->xform.translation(priv->pos);
-		priv->xform *= priv->rot.calc_matrix();
-		priv->xform.scale(priv->scale);
+	return priv->xfstore->get_local(priv->xfslot);
+}
+
+const Mat4 &Widget::get_world_xform() const
+{
+	return priv->xfstore->get_world(priv->xfslot);
+}
+
+const Mat4 &Widget::get_inv_world_xform() const
+{
+	return priv->xfstore->get_inv_world(priv->xfslot);
+}
+
+void Widget::update_xform() const
+{
+	get_world_xform();
+
+	int nchild = priv->children.size();
+	for(int i=0; i<nchild; i++) {
+		priv->children[i]->update_xform();
+	}
+}
+
+void Widget::invalidate_xform()
+{
+	priv->xfstore->invalidate_local(priv->xfslot);
+	invalidate_world_xform();
+}
+
+void Widget::invalidate_world_xform()
+{
+	if(!priv->xfstore->invalidate_world(priv->xfslot)) {
+		return;	// the whole subtree is already invalid
+	}
+	priv->bbox_valid = false;
+	mark_draw_dirty(this);
+
+	int nchild = priv->children.size();
+	for(int i=0; i<nchild; i++) {
+		priv->children[i]->invalidate_world_xform();
 	}
-	return priv->xform;
 }
 
 Widget *Widget::get_parent() const
@@ -119,23 +211,32 @@ void Widget::add_child(Widget *c)
 		if(cpar) {
 			cpar->remove_child(c);
 		}
+		c->priv->child_idx = priv->children.size();
 		priv->children.push_back(c);
 		c->priv->parent = this;
+		priv->xfstore->set_parent(c->priv->xfslot, priv->xfslot);
+		c->invalidate_world_xform();
 	}
 }
 
 bool Widget::remove_child(Widget *c)
 {
-	Widget *cpar = c->get_parent();
-	if(cpar == this) {
-		auto it = std::find(priv->children.begin(), priv->children.end(), c);
-		if(it != priv->children.end()) {
-			priv->children.erase(it);
-			c->priv->parent = 0;
-			return true;
-		}
+	if(c->get_parent() != this) {
+		return false;
 	}
-	return false;
+
+	// swap with the last child and pop
+	int idx = c->priv->child_idx;
+	Widget *last = priv->children.back();
+	priv->children[idx] = last;
+	last->priv->child_idx = idx;
+	priv->children.pop_back();
+
+	c->priv->parent = 0;
+	c->priv->child_idx = -1;
+	priv->xfstore->set_parent(c->priv->xfslot, -1);
+	c->invalidate_world_xform();
+	return true;
 }
 
 int Widget::num_children() const
@@ -155,6 +256,11 @@ Widget *Widget::get_child(int idx) const
 void Widget::set_shape(Shape *s)
 {
 	priv->shape = s;
+	priv->bbox_valid = false;
+	if(s) {
+		s->set_widget(this);
+	}
+	mark_draw_dirty(this);
 }
 
 Shape *Widget::get_shape() const
@@ -162,10 +268,75 @@ Shape *Widget::get_shape() const
 	return priv->shape;
 }
 
+bool Widget::get_bounds(Vec3 *bmin, Vec3 *bmax) const
+{
+	Shape *shape = priv->shape;
+	if(!shape) return false;
+
+	if(priv->bbox_valid && priv->bbox_shape_rev != shape->get_revision()) {
+		priv->bbox_valid = false;
+	}
+
+	if(!priv->bbox_valid) {
+		priv->has_bbox = shape->get_aabbox(&priv->bbox);
+		if(priv->has_bbox) {
+			priv->bbox.transform(get_world_xform());
+		}
+		priv->bbox_shape_rev = shape->get_revision();
+		priv->bbox_valid = true;
+	}
+
+	if(!priv->has_bbox) {
+		return false;
+	}
+	*bmin = priv->bbox.min;
+	*bmax = priv->bbox.max;
+	return true;
+}
+
+void Widget::set_color(const Vec4 &color)
+{
+	priv->color = color;
+	mark_draw_dirty(this);
+}
+
+const Vec4 &Widget::get_color() const
+{
+	return priv->color;
+}
+
+void Widget::set_shader(unsigned int sdr)
+{
+	priv->sdr = sdr;
+	mark_draw_dirty(this);
+}
+
+unsigned int Widget::get_shader() const
+{
+	return priv->sdr;
+}
+
 void Widget::set_draw_func(void (*func)(const Widget*, void*), void *cls)
 {
 	priv->draw_func = func;
 	priv->draw_func_cls = cls;
+	mark_draw_dirty(this);
+}
+
+bool Widget::has_draw_func() const
+{
+	return priv->draw_func != 0;
+}
+
+void Widget::set_static(bool s)
+{
+	priv->is_static = s;
+	mark_draw_dirty(this);
+}
+
+bool Widget::is_static() const
+{
+	return priv->is_static;
 }
 
 void Widget::draw() const
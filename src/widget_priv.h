@@ -0,0 +1,90 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef WIDGET_PRIV_H_
+#define WIDGET_PRIV_H_
+
+/* Widget internals, shared with the other parts of vrtk which need fast
+ * access to them (WidgetGroup and friends). Not installed.
+ */
+#include <vector>
+#include "widget.h"
+#include "geom.h"
+#include "pool.h"
+#include "xform_store.h"
+
+namespace vrtk {
+
+class Shape;
+class WidgetGroup;
+
+// what the group recorded for a widget the last time it looked at it
+enum {
+	DRAW_NONE,		// hidden, or not recorded yet
+	DRAW_VISIBLE,
+	DRAW_CULLED
+};
+
+class WidgetPriv : public PoolObject {
+public:
+	Widget *parent;
+	std::vector<Widget*> children;
+	int child_idx;	// index in the children of the parent
+
+	WidgetGroup *group;
+	int group_idx;	// index in the widget list of the group, and its draw list
+	bool draw_dirty;	// queued for re-recording by the group
+	int draw_state;
+	float fade;		// value of visible as of the last record, drawn if > 0
+	bool pick_dirty;	// picking bounds of the group need updating
+
+	unsigned int handle_idx, handle_gen;
+
+	XFormStore *xfstore;
+	int xfslot;		// position, rotation, scaling and matrices live in xfstore
+
+	Shape *shape;
+
+	// cached world-space bounds
+	AABox bbox;
+	bool bbox_valid, has_bbox;
+	unsigned int bbox_shape_rev;
+
+	Vec4 color;
+	unsigned int sdr;
+
+	void (*draw_func)(const Widget*, void*);
+	void *draw_func_cls;
+
+	bool is_static;
+	int batch_idx;	// index in the merged batch of the group, or -1
+
+	BoolAnim visible, focused, hover, grabbed, active;
+	Vec3 grab_pos;
+	Quat grab_rot;
+};
+
+WidgetPriv *widget_priv(const Widget *w);
+
+/* queues the widget to be recorded again by its group. Called by everything
+ * which changes how, or whether, a widget is drawn.
+ */
+void mark_draw_dirty(Widget *w);
+
+}	// namespace vrtk
+
+#endif	// WIDGET_PRIV_H_
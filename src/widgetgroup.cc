@@ -16,27 +16,160 @@ You should have received a copy of the GNU Lesser General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include <float.h>
+#include <string.h>
 #include <vector>
+#include <algorithm>
 #include "widgetgroup.h"
+#include "widget_priv.h"
+#include "scene.h"
+#include "input.h"
 #include "shape.h"
+#include "shape_caps.h"
 #include "geom.h"
+#include "render_queue.h"
+#include "mesh_batch.h"
+#include "layer_cache.h"
+#include "caps_impostor.h"
+#include "glstate.h"
+#include "parallel.h"
+#include "stats_priv.h"
+#include "trace_priv.h"
 
 namespace vrtk {
 
+// below this many widgets per thread, recording isn't worth splitting
+#define RECORD_CHUNK_SIZE	512
+
+// world-space bounds of a widget, for picking
+struct PickBounds {
+	Vec3 min, max;
+};
+
+// consecutive widgets sharing a bounding box, tested first when picking
+#define PICK_CLUSTER	64
+
+struct RecordChunk {
+	int num_visible, num_culled;
+	bool changed;
+};
+
 class WidgetGroupPriv {
 public:
 	std::vector<Widget*> widgets;
+
+	Frustum frustum;
+	bool culling;
+
+	/* retained draw list, one slot per widget in the same order, updated
+	 * in place by record
+	 */
+	RenderQueue rqueue;
+	std::vector<RecordChunk> chunks;	// per thread recording output
+	MeshBatch *batch;	// static widgets, when static merging is enabled
+
+	CapsImpostors *impostors;	// when capsule impostors are enabled
+
+	LayerCache *layer;	// when layer caching is enabled
+	bool layer_dirty;
+	Vec3 viewer;
+	AABox bounds;		// of all widgets shown, for the layer
+	bool has_bounds;
+
+	/* widgets to record again, see mark_draw_dirty. Widgets in the middle of
+	 * an animation stay in the list until it ends.
+	 */
+	std::vector<Widget*> dirty;
+	bool recull;		// culling changed, all widgets need recording
+	bool changed;		// any widget marked dirty since the last record
+	bool order_dirty;	// the draw list needs sorting
+
+	/* bounds of all widgets in the same order, tested before the shapes
+	 * when picking, and the widgets whose bounds need updating first
+	 */
+	std::vector<PickBounds> pick_bounds;
+	std::vector<Widget*> pick_dirty;
+	/* bounds of each run of PICK_CLUSTER widgets, rebuilt when any of their
+	 * widgets changes, or all of them when widgets are removed
+	 */
+	std::vector<PickBounds> pick_clusters;
+	std::vector<bool> cluster_dirty;
+	bool clusters_valid;
+
+	// draw statistics of the last frame
+	int num_visible, num_culled;
 };
 
+void mark_draw_dirty(Widget *w)
+{
+	WidgetPriv *wpriv = widget_priv(w);
+	if(!wpriv->group) return;
+
+	wpriv->group->priv->changed = true;
+	if(!wpriv->draw_dirty) {
+		wpriv->draw_dirty = true;
+		wpriv->group->priv->dirty.push_back(w);
+	}
+	if(!wpriv->pick_dirty) {
+		wpriv->pick_dirty = true;
+		wpriv->group->priv->pick_dirty.push_back(w);
+	}
+}
+
+static void remove_dirty(std::vector<Widget*> &list, Widget *w)
+{
+	// order doesn't matter in the dirty lists
+	std::vector<Widget*>::iterator it = std::find(list.begin(), list.end(), w);
+	*it = list.back();
+	list.pop_back();
+}
+
+static void mark_all_dirty(WidgetGroupPriv *priv)
+{
+	int num = priv->widgets.size();
+	for(int i=0; i<num; i++) {
+		mark_draw_dirty(priv->widgets[i]);
+	}
+}
+
+static inline void count_state(WidgetGroupPriv *priv, int state, int inc)
+{
+	if(state == DRAW_VISIBLE) {
+		priv->num_visible += inc;
+	} else if(state == DRAW_CULLED) {
+		priv->num_culled += inc;
+	}
+}
+
 WidgetGroup::WidgetGroup()
 {
 	priv = new WidgetGroupPriv;
+	priv->culling = false;
+	priv->batch = 0;
+	priv->impostors = 0;
+	priv->layer = 0;
+	priv->layer_dirty = true;
+	priv->has_bounds = false;
+	priv->viewer = Vec3(0, 0, 0);
+	priv->recull = false;
+	priv->changed = true;
+	priv->order_dirty = false;
+	priv->clusters_valid = false;
+
+	priv->num_visible = priv->num_culled = 0;
 }
 
 WidgetGroup::~WidgetGroup()
 {
+	input_remove_group(this);
+
+	delete priv->batch;
+	delete priv->impostors;
+	delete priv->layer;
+
 	int num = priv->widgets.size();
 	for(int i=0; i<num; i++) {
+		// detach first, so that the widget destructor leaves our list alone
+		widget_priv(priv->widgets[i])->group = 0;
 		delete priv->widgets[i];
 	}
 	delete priv;
@@ -44,64 +177,815 @@ WidgetGroup::~WidgetGroup()
 
 void WidgetGroup::add_widget(Widget *w)
 {
-	int num = priv->widgets.size();
-	for(int i=0; i<num; i++) {
-		if(priv->widgets[i] == w) return;
-	}
+	WidgetPriv *wpriv = widget_priv(w);
+	if(wpriv->group == this) return;
 
+	if(wpriv->group) {
+		wpriv->group->remove_widget(w);
+	}
+	wpriv->group = this;
+	wpriv->group_idx = priv->widgets.size();
 	priv->widgets.push_back(w);
+	priv->rqueue.resize(priv->widgets.size());
+	priv->pick_bounds.resize(priv->widgets.size());
+	priv->clusters_valid = false;
+
+	wpriv->draw_state = DRAW_NONE;
+	mark_draw_dirty(w);
 }
 
 bool WidgetGroup::remove_widget(Widget *w)
 {
-	int num = priv->widgets.size();
+	WidgetPriv *wpriv = widget_priv(w);
+	if(wpriv->group != this) {
+		return false;
+	}
+
+	if(priv->batch) {
+		priv->batch->remove(w);
+	}
+
+	if(wpriv->draw_dirty) {
+		remove_dirty(priv->dirty, w);
+		wpriv->draw_dirty = false;
+	}
+	if(wpriv->pick_dirty) {
+		remove_dirty(priv->pick_dirty, w);
+		wpriv->pick_dirty = false;
+	}
+	count_state(priv, wpriv->draw_state, -1);
+	wpriv->draw_state = DRAW_NONE;
+
+	// swap with the last widget and pop, and the same for its draw list slot
+	int idx = wpriv->group_idx;
+	Widget *last = priv->widgets.back();
+	priv->widgets[idx] = last;
+	widget_priv(last)->group_idx = idx;
+	priv->widgets.pop_back();
+
+	priv->rqueue.remove_slot(idx);
+	priv->order_dirty = true;
+	priv->pick_bounds[idx] = priv->pick_bounds.back();
+	priv->pick_bounds.pop_back();
+	priv->clusters_valid = false;
+
+	wpriv->group = 0;
+	wpriv->group_idx = -1;
+	return true;
+}
+
+void WidgetGroup::update() const
+{
+	update_xforms();
+}
+
+/* hidden widgets can't be picked. Only checked after a widget passes the
+ * cheaper tests, since it reads the clock.
+ */
+static inline bool is_shown(const Widget *w)
+{
+	return widget_priv(w)->visible.get_state();
+}
+
+/* widgets without shapes get empty bounds, which nothing hits, and shapes
+ * which can't be bounded get infinite ones
+ */
+static void update_pick_bounds(WidgetGroupPriv *priv)
+{
+	int num_clusters = (priv->widgets.size() + PICK_CLUSTER - 1) / PICK_CLUSTER;
+	if(!priv->clusters_valid) {
+		priv->pick_clusters.resize(num_clusters);
+		priv->cluster_dirty.assign(num_clusters, true);
+	} else if(priv->pick_dirty.empty()) {
+		return;
+	}
+
+	int num = priv->pick_dirty.size();
 	for(int i=0; i<num; i++) {
-		if(priv->widgets[i] == w) {
-			priv->widgets.erase(priv->widgets.begin() + i);
-			return true;
+		Widget *w = priv->pick_dirty[i];
+		WidgetPriv *wpriv = widget_priv(w);
+		PickBounds *pb = &priv->pick_bounds[wpriv->group_idx];
+
+		if(!w->get_shape()) {
+			pb->min = Vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+			pb->max = Vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		} else if(!w->get_bounds(&pb->min, &pb->max)) {
+			pb->min = Vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			pb->max = Vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+		}
+		wpriv->pick_dirty = false;
+		priv->cluster_dirty[wpriv->group_idx / PICK_CLUSTER] = true;
+	}
+	priv->pick_dirty.clear();
+
+	int num_widgets = priv->widgets.size();
+	for(int i=0; i<num_clusters; i++) {
+		if(!priv->cluster_dirty[i]) continue;
+
+		PickBounds *cb = &priv->pick_clusters[i];
+		cb->min = Vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+		cb->max = Vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+		int end = std::min((i + 1) * PICK_CLUSTER, num_widgets);
+		for(int j=i * PICK_CLUSTER; j<end; j++) {
+			const PickBounds &pb = priv->pick_bounds[j];
+			cb->min.x = std::min(cb->min.x, pb.min.x);
+			cb->min.y = std::min(cb->min.y, pb.min.y);
+			cb->min.z = std::min(cb->min.z, pb.min.z);
+			cb->max.x = std::max(cb->max.x, pb.max.x);
+			cb->max.y = std::max(cb->max.y, pb.max.y);
+			cb->max.z = std::max(cb->max.z, pb.max.z);
 		}
+		priv->cluster_dirty[i] = false;
 	}
-	return false;
+	priv->clusters_valid = true;
+}
+
+static inline bool point_in_box(const Vec3 &pt, const PickBounds &pb)
+{
+	return pt.x >= pb.min.x && pt.y >= pb.min.y && pt.z >= pb.min.z &&
+		pt.x <= pb.max.x && pt.y <= pb.max.y && pt.z <= pb.max.z;
+}
+
+bool WidgetGroup::contains(const Vec3 &pt, Widget **wres) const
+{
+	Widget *w;
+	contains(1, &pt, &w);
+	if(wres) *wres = w;
+	return w != 0;
 }
 
-bool WidgetGroup::contains(const Vec3 &pt) const
+/* all points are tested against each widget in turn, so the widgets and their
+ * bounds are walked once for the whole batch
+ */
+int WidgetGroup::contains(int count, const Vec3 *pts, Widget **wres) const
 {
+	TRACE_ZONE("WidgetGroup::contains");
+
+	update_pick_bounds(priv);
+
+	for(int i=0; i<count; i++) {
+		wres[i] = 0;
+	}
+
+	int num_found = 0;
 	int num = priv->widgets.size();
-	for(int i=0; i<num; i++) {
-		Shape *shape = priv->widgets[i]->get_shape();
-		if(shape->contains(pt)) {
-			return true;
+	for(int c=0; c * PICK_CLUSTER < num && num_found < count; c++) {
+		const PickBounds &cb = priv->pick_clusters[c];
+		bool any = false;
+		for(int j=0; j<count; j++) {
+			if(!wres[j] && point_in_box(pts[j], cb)) {
+				any = true;
+				break;
+			}
+		}
+		if(!any) continue;
+
+		int end = std::min((c + 1) * PICK_CLUSTER, num);
+		for(int i=c * PICK_CLUSTER; i<end; i++) {
+			const PickBounds &pb = priv->pick_bounds[i];
+
+			for(int j=0; j<count; j++) {
+				if(wres[j] || !point_in_box(pts[j], pb)) continue;
+
+				Widget *w = priv->widgets[i];
+				if(w->get_shape()->contains(w->get_inv_world_xform() * pts[j]) && is_shown(w)) {
+					wres[j] = w;
+					num_found++;
+				}
+			}
 		}
 	}
-	return false;
+	return num_found;
+}
+
+/* slab test of a ray against a world-space box, rejecting boxes entered
+ * beyond tmax. Cheaper than taking the ray into the space of the shape.
+ */
+static inline bool ray_box(const Ray &ray, const Vec3 &inv_dir, const Vec3 &bmin,
+		const Vec3 &bmax, float tmax)
+{
+	float t0 = (bmin.x - ray.origin.x) * inv_dir.x;
+	float t1 = (bmax.x - ray.origin.x) * inv_dir.x;
+	float tmin = std::min(t0, t1);
+	float tend = std::max(t0, t1);
+
+	t0 = (bmin.y - ray.origin.y) * inv_dir.y;
+	t1 = (bmax.y - ray.origin.y) * inv_dir.y;
+	tmin = std::max(tmin, std::min(t0, t1));
+	tend = std::min(tend, std::max(t0, t1));
+
+	t0 = (bmin.z - ray.origin.z) * inv_dir.z;
+	t1 = (bmax.z - ray.origin.z) * inv_dir.z;
+	tmin = std::max(tmin, std::min(t0, t1));
+	tend = std::min(tend, std::max(t0, t1));
+
+	return tend >= tmin && tend >= 0.0f && tmin <= tmax;
 }
 
 bool WidgetGroup::intersect(const Ray &ray, HitPoint *hit) const
 {
-	HitPoint nearest;
-	nearest.obj = 0;
-	nearest.t = FLT_MAX;
+	HitPoint tmp;
+	intersect(1, &ray, hit ? hit : &tmp);
+	return (hit ? hit : &tmp)->obj != 0;
+}
+
+// rays per walk over the widgets, so that their inverse directions fit on the stack
+#define PICK_BATCH	16
+
+/* shapes are tested in their local space, and the nearest hit is taken back
+ * to world space. The ray parameter t is the same in both spaces, since the
+ * direction gets transformed along with the origin. Widgets whose bounds the
+ * ray misses, or enters further than the nearest hit so far, are skipped,
+ * and so are whole clusters of them. Each cluster is tested against all
+ * rays of the batch at once.
+ */
+int WidgetGroup::intersect(int count, const Ray *rays, HitPoint *hits) const
+{
+	TRACE_ZONE("WidgetGroup::intersect");
 
+	update_pick_bounds(priv);
+
+	int num_hits = 0;
 	int num = priv->widgets.size();
-	for(int i=0; i<num; i++) {
-		Shape *shape = priv->widgets[i]->get_shape();
-		if(shape->intersect(ray, hit) && hit && hit->t < nearest.t) {
-			nearest = *hit;
+	long num_tested = 0;
+
+	for(int first=0; first<count; first+=PICK_BATCH) {
+		int nrays = std::min(count - first, PICK_BATCH);
+		const Ray *ray = rays + first;
+		HitPoint *nearest = hits + first;
+
+		Vec3 inv_dir[PICK_BATCH];
+		for(int i=0; i<nrays; i++) {
+			inv_dir[i] = Vec3(1.0f / ray[i].dir.x, 1.0f / ray[i].dir.y, 1.0f / ray[i].dir.z);
+			nearest[i].obj = 0;
+			nearest[i].t = FLT_MAX;
+		}
+
+		for(int c=0; c * PICK_CLUSTER < num; c++) {
+			// rays which enter the cluster, one bit each
+			const PickBounds &cb = priv->pick_clusters[c];
+			unsigned int mask = 0;
+			for(int j=0; j<nrays; j++) {
+				if(ray_box(ray[j], inv_dir[j], cb.min, cb.max, nearest[j].t)) {
+					mask |= 1 << j;
+				}
+			}
+			if(!mask) continue;
+
+			int end = std::min((c + 1) * PICK_CLUSTER, num);
+			for(int i=c * PICK_CLUSTER; i<end; i++) {
+				const PickBounds &pb = priv->pick_bounds[i];
+
+				for(int j=0; j<nrays; j++) {
+					if(!(mask & (1 << j)) || !ray_box(ray[j], inv_dir[j], pb.min, pb.max, nearest[j].t)) {
+						continue;
+					}
+
+					Widget *w = priv->widgets[i];
+					HitPoint lhit;
+					num_tested++;
+					if(w->get_shape()->intersect(w->get_inv_world_xform() * ray[j], &lhit) &&
+							lhit.t < nearest[j].t && is_shown(w)) {
+						nearest[j] = lhit;
+						nearest[j].obj = w;
+					}
+				}
+			}
+		}
+
+		for(int i=0; i<nrays; i++) {
+			if(!nearest[i].obj) continue;
+
+			const Widget *w = (const Widget*)nearest[i].obj;
+			Mat4 norm_xform = transpose(w->get_inv_world_xform()).upper3x3();
+
+			nearest[i].pos = w->get_world_xform() * nearest[i].pos;
+			nearest[i].norm = normalize(norm_xform * nearest[i].norm);
+			num_hits++;
 		}
 	}
 
-	if(nearest.obj && hit) {
-		*hit = nearest;
+	STAT_ADD(STAT_RAYS, count);
+	STAT_ADD(STAT_SHAPES_TESTED, num_tested);
+	return num_hits;
+}
+
+static void set_frustum(WidgetGroupPriv *priv, const Frustum &frust)
+{
+	if(!priv->culling || memcmp(frust.plane, priv->frustum.plane, sizeof frust.plane) != 0) {
+		priv->frustum = frust;
+		priv->culling = true;
+		priv->recull = true;
 	}
-	return nearest.obj != 0;
 }
 
-void WidgetGroup::draw() const
+void WidgetGroup::set_view_frustum(const Mat4 &viewproj)
+{
+	Frustum frust;
+	frust.set_viewproj(viewproj);
+	set_frustum(priv, frust);
+}
+
+void WidgetGroup::set_view_frustum(const Mat4 &left_viewproj, const Mat4 &right_viewproj)
+{
+	Frustum frust;
+	frust.set_stereo(left_viewproj, right_viewproj);
+	set_frustum(priv, frust);
+}
+
+void WidgetGroup::disable_culling()
+{
+	if(priv->culling) {
+		priv->culling = false;
+		priv->recull = true;
+	}
+}
+
+/* visible widgets are queued and sorted by program, mesh and color, so that
+ * each of these only changes when it has to during submission
+ */
+void WidgetGroup::set_static_merging(bool enable)
+{
+	if(enable && !priv->batch) {
+		priv->batch = new MeshBatch;
+	} else if(!enable && priv->batch) {
+		delete priv->batch;
+		priv->batch = 0;
+	} else {
+		return;
+	}
+	// every widget may move in or out of the batch
+	mark_all_dirty(priv);
+}
+
+bool WidgetGroup::get_static_merging() const
+{
+	return priv->batch != 0;
+}
+
+void WidgetGroup::set_layer_caching(bool enable, int xsz, int ysz)
+{
+	if(enable) {
+		if(!priv->layer) {
+			priv->layer = new LayerCache;
+			priv->layer_dirty = true;
+			priv->recull = true;
+		}
+		priv->layer->set_resolution(xsz, ysz);
+	} else if(priv->layer) {
+		delete priv->layer;
+		priv->layer = 0;
+		priv->recull = true;
+	}
+}
+
+bool WidgetGroup::get_layer_caching() const
+{
+	return priv->layer != 0;
+}
+
+void WidgetGroup::set_layer_threshold(float angle)
+{
+	if(priv->layer) {
+		priv->layer->set_threshold(angle);
+	}
+}
+
+void WidgetGroup::set_viewer(const Vec3 &pos)
+{
+	priv->viewer = pos;
+}
+
+void WidgetGroup::set_capsule_impostors(bool enable)
+{
+	if(enable && !priv->impostors) {
+		priv->impostors = new CapsImpostors;
+	} else if(!enable && priv->impostors) {
+		delete priv->impostors;
+		priv->impostors = 0;
+	} else {
+		return;
+	}
+	mark_all_dirty(priv);
+}
+
+bool WidgetGroup::get_capsule_impostors() const
+{
+	return priv->impostors != 0;
+}
+
+/* opaque capsules drawn with the host program, and without non-uniform
+ * scaling, which would make them something other than capsules
+ */
+static bool can_impostor(const WidgetGroupPriv *priv, const Widget *w)
+{
+	if(!priv->impostors || w->has_draw_func() || w->get_shader()) {
+		return false;
+	}
+	Shape *shape = w->get_shape();
+	if(!shape || shape->get_type() != SHAPE_CAPSULOID) {
+		return false;
+	}
+	if(w->get_color().w < 1.0f || widget_priv(w)->fade < 1.0f) {
+		return false;
+	}
+
+	const Mat4 &xform = w->get_world_xform();
+	float sx = length(Vec3(xform[0][0], xform[0][1], xform[0][2]));
+	float sy = length(Vec3(xform[1][0], xform[1][1], xform[1][2]));
+	float sz = length(Vec3(xform[2][0], xform[2][1], xform[2][2]));
+	return fabs(sx - sy) <= sx * 1e-4f && fabs(sx - sz) <= sx * 1e-4f;
+}
+
+/* same as init_draw_item, without asking the shape for a mesh. If it ends
+ * up not drawn as an impostor, Widget::draw draws its mesh.
+ */
+static void init_impostor_item(DrawItem *item, const Widget *w)
 {
+	item->widget = w;
+	item->mesh = 0;
+	item->xform = &w->get_world_xform();
+	item->sdr = 0;
+	item->color = pack_color(w->get_color());
+	item->key = draw_key(0, 0, item->color);
+	item->impostor = true;
+}
+
+/* translucent widgets can't be merged, they have to be sorted by depth,
+ * and neither can widgets fading in or out. Impostors take precedence.
+ */
+static bool can_merge(const WidgetGroupPriv *priv, const Widget *w)
+{
+	if(!w->is_static() || w->has_draw_func() || w->get_shader()) {
+		return false;
+	}
+	if(can_impostor(priv, w)) {
+		return false;
+	}
+	if(w->get_color().w < 1.0f || widget_priv(w)->fade < 1.0f) {
+		return false;
+	}
+	Shape *shape = w->get_shape();
+	return shape && shape->get_mesh();
+}
+
+/* moves a widget in or out of the batch, as it becomes static or stops being
+ * mergeable, and re-bakes it if it's in there
+ */
+static void update_batch(WidgetGroupPriv *priv, Widget *w)
+{
+	MeshBatch *batch = priv->batch;
+	bool merge = can_merge(priv, w);
+
+	if(merge != batch->contains(w)) {
+		if(merge) {
+			batch->add(w);
+		} else {
+			batch->remove(w);
+		}
+	}
+	batch->update(w);
+}
+
+/* records a widget into its draw list slot, or marks it visible in the
+ * batch, and keeps its draw state. Returns true if what gets drawn changed.
+ * Only touches data of this widget, so it's safe to call in parallel.
+ */
+static bool record_widget(WidgetGroupPriv *priv, Widget *w)
+{
+	WidgetPriv *wpriv = widget_priv(w);
+	DrawItem *item = priv->rqueue.get_slot(wpriv->group_idx);
+	bool in_batch = wpriv->batch_idx >= 0;
+
+	int prev_state = wpriv->draw_state;
+	const Widget *prev_widget = item->widget;
+	uint64_t prev_key = item->key;
+
+	int state = DRAW_VISIBLE;
+	AABox box;
+	if(wpriv->fade <= 0.0f) {
+		state = DRAW_NONE;
+	} else if(priv->culling && !priv->layer && w->get_bounds(&box.min, &box.max)) {
+		if(!vrtk::intersect(priv->frustum, box)) {
+			state = DRAW_CULLED;
+		}
+	}
+
+	item->widget = 0;
+	if(state == DRAW_VISIBLE && !in_batch) {
+		if(can_impostor(priv, w)) {
+			init_impostor_item(item, w);
+		} else {
+			init_draw_item(item, w, wpriv->fade);
+		}
+	}
+	if(in_batch) {
+		priv->batch->set_visible(w, state == DRAW_VISIBLE);
+	}
+	wpriv->draw_state = state;
+
+	return state != prev_state || item->widget != prev_widget ||
+		(item->widget && item->key != prev_key);
+}
+
+static void record_chunk(int start, int end, void *cls)
+{
+	WidgetGroupPriv *priv = (WidgetGroupPriv*)cls;
+	int num = priv->widgets.size();
+	int num_chunks = priv->chunks.size();
+
+	for(int i=start; i<end; i++) {
+		RecordChunk *chunk = &priv->chunks[i];
+		chunk->num_visible = chunk->num_culled = 0;
+		chunk->changed = false;
+
+		int wend = (int)((long)num * (i + 1) / num_chunks);
+		for(int j=(int)((long)num * i / num_chunks); j<wend; j++) {
+			Widget *w = priv->widgets[j];
+
+			if(record_widget(priv, w)) {
+				chunk->changed = true;
+			}
+
+			int state = widget_priv(w)->draw_state;
+			if(state == DRAW_VISIBLE) {
+				chunk->num_visible++;
+			} else if(state == DRAW_CULLED) {
+				chunk->num_culled++;
+			}
+		}
+	}
+}
+
+// culls and records every widget, split over the worker threads
+static void record_all(WidgetGroupPriv *priv)
+{
+	int num = priv->widgets.size();
+	int num_chunks = num / RECORD_CHUNK_SIZE;
+	int max_chunks = (get_num_threads() + 1) * 2;
+	if(num_chunks > max_chunks) num_chunks = max_chunks;
+	if(num_chunks < 1) num_chunks = 1;
+
+	priv->chunks.resize(num_chunks);
+	parallel_for(num_chunks, 1, record_chunk, priv);
+
+	priv->num_visible = priv->num_culled = 0;
+	for(int i=0; i<num_chunks; i++) {
+		RecordChunk *chunk = &priv->chunks[i];
+		priv->num_visible += chunk->num_visible;
+		priv->num_culled += chunk->num_culled;
+		if(chunk->changed) {
+			priv->order_dirty = true;
+		}
+	}
+}
+
+// bounds of everything shown, culled or not
+static void calc_bounds(WidgetGroupPriv *priv)
+{
+	priv->has_bounds = false;
+
 	int num = priv->widgets.size();
 	for(int i=0; i<num; i++) {
-		priv->widgets[i]->draw();
+		Widget *w = priv->widgets[i];
+		AABox box;
+		if(widget_priv(w)->draw_state == DRAW_NONE || !w->get_bounds(&box.min, &box.max)) {
+			continue;
+		}
+
+		if(!priv->has_bounds) {
+			priv->bounds = box;
+			priv->has_bounds = true;
+		} else {
+			priv->bounds.min = Vec3(std::min(box.min.x, priv->bounds.min.x),
+					std::min(box.min.y, priv->bounds.min.y), std::min(box.min.z, priv->bounds.min.z));
+			priv->bounds.max = Vec3(std::max(box.max.x, priv->bounds.max.x),
+					std::max(box.max.y, priv->bounds.max.y), std::max(box.max.z, priv->bounds.max.z));
+		}
+	}
+}
+
+// world space capsules of the impostor items in the draw list
+static void build_impostors(WidgetGroupPriv *priv)
+{
+	CapsImpostors *imp = priv->impostors;
+	imp->clear();
+
+	int num = priv->widgets.size();
+	for(int i=0; i<num; i++) {
+		const DrawItem *item = priv->rqueue.get_slot(i);
+		if(!item->widget || !item->impostor) continue;
+
+		const ShapeCaps *caps = (const ShapeCaps*)item->widget->get_shape();
+		const Mat4 &xform = *item->xform;
+		float scale = length(Vec3(xform[0][0], xform[0][1], xform[0][2]));
+
+		imp->add(xform * caps->get_end(0), xform * caps->get_end(1),
+				caps->get_radius() * scale, item->color);
+	}
+}
+
+static bool in_transition(WidgetPriv *wpriv)
+{
+	return wpriv->visible.get_dir() != 0.0f || wpriv->focused.get_dir() != 0.0f ||
+		wpriv->hover.get_dir() != 0.0f || wpriv->grabbed.get_dir() != 0.0f ||
+		wpriv->active.get_dir() != 0.0f;
+}
+
+/* the draw list is retained between frames, and only the widgets which
+ * changed since (see mark_draw_dirty) are recorded again, unless culling
+ * changed. With nothing changed, record does nothing.
+ */
+void WidgetGroup::record() const
+{
+	TRACE_ZONE("WidgetGroup::record");
+
+	update();
+
+	std::vector<Widget*> &dirty = priv->dirty;
+	int num_dirty = dirty.size();
+
+	/* lazily computed shape data (bounds, meshes) may be shared between
+	 * widgets, so bring it up to date before going parallel. Past this point
+	 * recording only reads shapes.
+	 */
+	for(int i=0; i<num_dirty; i++) {
+		Widget *w = dirty[i];
+		WidgetPriv *wpriv = widget_priv(w);
+		wpriv->fade = wpriv->visible.get_value();
+
+		Shape *shape = w->get_shape();
+		if(shape && !can_impostor(priv, w)) {
+			shape->get_mesh();
+		}
+		if(priv->batch) {
+			bool was_batched = priv->batch->contains(w);
+			update_batch(priv, w);
+			if(was_batched || priv->batch->contains(w)) {
+				priv->order_dirty = true;	// re-baking may move its range
+			}
+		}
+	}
+
+	bool changed = num_dirty || priv->recull;
+
+	if(priv->recull) {
+		record_all(priv);
+		priv->recull = false;
+	} else {
+		for(int i=0; i<num_dirty; i++) {
+			Widget *w = dirty[i];
+			WidgetPriv *wpriv = widget_priv(w);
+
+			count_state(priv, wpriv->draw_state, -1);
+			if(record_widget(priv, w)) {
+				priv->order_dirty = true;
+			}
+			count_state(priv, wpriv->draw_state, 1);
+		}
+	}
+
+	if(changed || priv->order_dirty) {
+		priv->layer_dirty = true;
+		if(priv->layer) {
+			calc_bounds(priv);
+		}
+		if(priv->impostors) {
+			build_impostors(priv);
+		}
+	}
+
+	int num_keep = 0;
+	for(int i=0; i<num_dirty; i++) {
+		WidgetPriv *wpriv = widget_priv(dirty[i]);
+		if(in_transition(wpriv)) {
+			dirty[num_keep++] = dirty[i];
+		} else {
+			wpriv->draw_dirty = false;
+		}
 	}
+	dirty.resize(num_keep);
+	priv->changed = false;
+
+	if(priv->order_dirty) {
+		priv->rqueue.sort();
+		if(priv->batch) {
+			priv->batch->prepare();
+		}
+		priv->order_dirty = false;
+	}
+	// the viewer moves every frame, but this is only for translucent widgets
+	priv->rqueue.sort_depth(priv->viewer);
+}
+
+static void submit_direct(WidgetGroupPriv *priv, int instances)
+{
+	// impostors can't do instanced stereo, those capsules get drawn as meshes
+	bool impostors = priv->impostors && instances == 1 && priv->impostors->init_gl();
+
+	priv->rqueue.submit(instances, impostors);
+	if(priv->batch) {
+		priv->batch->draw(instances);
+	}
+	if(impostors) {
+		priv->impostors->draw();
+	}
+	priv->rqueue.submit_translucent(instances);
+}
+
+static void draw_layer(void *cls)
+{
+	submit_direct((WidgetGroupPriv*)cls, 1);
+}
+
+/* draws the layer, rendering it first if it's out of date. Returns false if
+ * the group has to be drawn directly instead.
+ */
+static bool submit_layer(WidgetGroupPriv *priv)
+{
+	if(!priv->has_bounds) {
+		return true;	// nothing to draw
+	}
+	if(priv->culling && !vrtk::intersect(priv->frustum, priv->bounds)) {
+		return true;
+	}
+
+	LayerCache *layer = priv->layer;
+	if(priv->layer_dirty || !layer->is_valid(priv->viewer)) {
+		if(!layer->render(priv->bounds, priv->viewer, draw_layer, priv)) {
+			return false;
+		}
+		priv->layer_dirty = false;
+	}
+	layer->draw();
+	return true;
+}
+
+void WidgetGroup::submit(int instances) const
+{
+	TRACE_ZONE("WidgetGroup::submit");
+
+	gl_begin_frame();
+
+	if(priv->layer && instances == 1 && submit_layer(priv)) {
+		return;
+	}
+	submit_direct(priv, instances);
+}
+
+void WidgetGroup::draw() const
+{
+	TRACE_ZONE("WidgetGroup::draw");
+
+	record();
+	submit();
+}
+
+void WidgetGroup::draw_stereo(void (*setup_eye)(int, void*), void *cls) const
+{
+	TRACE_ZONE("WidgetGroup::draw_stereo");
+
+	record();
+
+	for(int i=0; i<2; i++) {
+		setup_eye(i, cls);
+		submit();
+	}
+}
+
+void WidgetGroup::draw_stereo_instanced() const
+{
+	TRACE_ZONE("WidgetGroup::draw_stereo_instanced");
+
+	record();
+	submit(2);
+}
+
+bool WidgetGroup::need_redraw(long *next_change) const
+{
+	bool redraw = vrtk::need_redraw(next_change);
+
+	if(priv->changed || priv->recull || priv->order_dirty) {
+		return true;
+	}
+	if(priv->batch && priv->batch->need_upload()) {
+		return true;
+	}
+	if(priv->layer && (priv->layer_dirty || !priv->layer->is_valid(priv->viewer))) {
+		return true;
+	}
+	return redraw;
+}
+
+int WidgetGroup::get_num_visible() const
+{
+	return priv->num_visible;
+}
+
+int WidgetGroup::get_num_culled() const
+{
+	return priv->num_culled;
 }
 
 }	// namespace vrtk
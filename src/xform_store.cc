@@ -0,0 +1,462 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <string.h>
+#include "xform_store.h"
+#include "parallel.h"
+#include "scene.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define USE_SSE
+#endif
+
+namespace vrtk {
+
+// below these sizes the batch passes don't bother with the worker threads
+#define PAR_MIN_BLOCKS	4
+#define PAR_MIN_SLOTS	2048
+
+struct XFormJob {
+	XFormStore *store;
+	int offset;
+
+	static void local(int start, int end, void *cls)
+	{
+		((XFormJob*)cls)->store->local_range(start, end);
+	}
+
+	static void world(int start, int end, void *cls)
+	{
+		XFormJob *job = (XFormJob*)cls;
+		job->store->world_range(job->offset + start, job->offset + end);
+	}
+};
+
+static void calc_trs(const Vec3 &pos, const Quat &rot, const Vec3 &scale, Mat4 *mat, Mat4 *inv);
+#ifdef USE_SSE
+static void calc_trs4(const Vec3 *pos, const Quat *rot, const Vec3 *scale, Mat4 *mat, Mat4 *inv);
+#endif
+
+XFormStore *get_xform_store()
+{
+	// intentionally never destroyed: widgets may be deleted during static destruction
+	static XFormStore *store = new XFormStore;
+	return store;
+}
+
+void update_xforms()
+{
+	get_xform_store()->update();
+}
+
+bool XFormStore::is_dirty() const
+{
+	return dirty;
+}
+
+XFormStore::XFormStore()
+{
+	num_slots = 0;
+	order_valid = false;
+	dirty = false;
+}
+
+XFormStore::~XFormStore()
+{
+	for(size_t i=0; i<blocks.size(); i++) {
+		delete blocks[i];
+	}
+}
+
+int XFormStore::alloc()
+{
+	int slot;
+	if(!free_slots.empty()) {
+		slot = free_slots.back();
+		free_slots.pop_back();
+	} else {
+		if(num_slots % XFORM_BLOCK_SIZE == 0) {
+			XFormBlock *blk = new XFormBlock;
+			memset(blk->flags, 0, sizeof blk->flags);
+			blk->num_local_dirty = 0;
+			blocks.push_back(blk);
+		}
+		slot = num_slots++;
+	}
+
+	XFormBlock *blk = block(slot);
+	int idx = index(slot);
+	blk->pos[idx] = Vec3(0, 0, 0);
+	blk->rot[idx] = Quat(0, 0, 0, 1);
+	blk->scale[idx] = Vec3(1, 1, 1);
+	blk->parent[idx] = -1;
+	blk->flags[idx] = XFORM_USED | XFORM_LOCAL_DIRTY | XFORM_WORLD_DIRTY;
+	blk->num_local_dirty++;
+
+	order_valid = false;
+	dirty = true;
+	return slot;
+}
+
+void XFormStore::free(int slot)
+{
+	XFormBlock *blk = block(slot);
+	int idx = index(slot);
+
+	if(blk->flags[idx] & XFORM_LOCAL_DIRTY) {
+		blk->num_local_dirty--;
+	}
+	blk->flags[idx] = 0;
+	free_slots.push_back(slot);
+	order_valid = false;
+}
+
+void XFormStore::set_pos(int slot, const Vec3 &pos)
+{
+	block(slot)->pos[index(slot)] = pos;
+}
+
+void XFormStore::set_rot(int slot, const Quat &rot)
+{
+	block(slot)->rot[index(slot)] = rot;
+}
+
+void XFormStore::set_scale(int slot, const Vec3 &scale)
+{
+	block(slot)->scale[index(slot)] = scale;
+}
+
+void XFormStore::set_parent(int slot, int parent)
+{
+	block(slot)->parent[index(slot)] = parent;
+	order_valid = false;
+}
+
+void XFormStore::invalidate_local(int slot)
+{
+	XFormBlock *blk = block(slot);
+	int idx = index(slot);
+
+	if(!(blk->flags[idx] & XFORM_LOCAL_DIRTY)) {
+		blk->flags[idx] |= XFORM_LOCAL_DIRTY;
+		blk->num_local_dirty++;
+	}
+	dirty = true;
+}
+
+bool XFormStore::invalidate_world(int slot)
+{
+	XFormBlock *blk = block(slot);
+	int idx = index(slot);
+
+	if(blk->flags[idx] & XFORM_WORLD_DIRTY) {
+		return false;
+	}
+	blk->flags[idx] |= XFORM_WORLD_DIRTY;
+	dirty = true;
+	return true;
+}
+
+void XFormStore::calc_local(int slot)
+{
+	XFormBlock *blk = block(slot);
+	int idx = index(slot);
+
+	calc_trs(blk->pos[idx], blk->rot[idx], blk->scale[idx], blk->local + idx, blk->inv_local + idx);
+	blk->flags[idx] &= ~XFORM_LOCAL_DIRTY;
+	blk->num_local_dirty--;
+}
+
+const Mat4 &XFormStore::get_local(int slot)
+{
+	XFormBlock *blk = block(slot);
+	int idx = index(slot);
+
+	if(blk->flags[idx] & XFORM_LOCAL_DIRTY) {
+		calc_local(slot);
+	}
+	return blk->local[idx];
+}
+
+const Mat4 &XFormStore::get_world(int slot)
+{
+	XFormBlock *blk = block(slot);
+	int idx = index(slot);
+
+	if(blk->flags[idx] & XFORM_WORLD_DIRTY) {
+		get_local(slot);
+
+		int par = blk->parent[idx];
+		if(par >= 0) {
+			blk->world[idx] = get_world(par) * blk->local[idx];
+			blk->inv_world[idx] = blk->inv_local[idx] * get_inv_world(par);
+		} else {
+			blk->world[idx] = blk->local[idx];
+			blk->inv_world[idx] = blk->inv_local[idx];
+		}
+		blk->flags[idx] &= ~XFORM_WORLD_DIRTY;
+	}
+	return blk->world[idx];
+}
+
+const Mat4 &XFormStore::get_inv_world(int slot)
+{
+	get_world(slot);
+	return block(slot)->inv_world[index(slot)];
+}
+
+/* sorts the used slots by their depth in the hierarchy (counting sort), so
+ * that each level only depends on levels before it.
+ */
+void XFormStore::build_order()
+{
+	std::vector<int> depth(num_slots, -1);
+	int max_depth = 0;
+
+	for(int i=0; i<num_slots; i++) {
+		if(!(block(i)->flags[index(i)] & XFORM_USED) || depth[i] >= 0) {
+			continue;
+		}
+
+		// walk up to the first slot of known depth, then back down
+		int d = 0;
+		int s = i;
+		while(s >= 0 && depth[s] < 0) {
+			s = get_parent(s);
+			d++;
+		}
+		d += s >= 0 ? depth[s] : -1;
+
+		s = i;
+		while(s >= 0 && depth[s] < 0) {
+			depth[s] = d--;
+			s = get_parent(s);
+		}
+		if(depth[i] > max_depth) {
+			max_depth = depth[i];
+		}
+	}
+
+	level_start.clear();
+	level_start.resize(max_depth + 2, 0);
+	for(int i=0; i<num_slots; i++) {
+		if(depth[i] >= 0) {
+			level_start[depth[i] + 1]++;
+		}
+	}
+	for(int i=1; i<(int)level_start.size(); i++) {
+		level_start[i] += level_start[i - 1];
+	}
+
+	std::vector<int> fill(level_start.begin(), level_start.end() - 1);
+	order.resize(level_start.back());
+	for(int i=0; i<num_slots; i++) {
+		if(depth[i] >= 0) {
+			order[fill[depth[i]]++] = i;
+		}
+	}
+	order_valid = true;
+}
+
+void XFormStore::update()
+{
+	if(!dirty) return;
+
+	if(!order_valid) {
+		build_order();
+	}
+
+	XFormJob job;
+	job.store = this;
+	job.offset = 0;
+
+	parallel_for((int)blocks.size(), PAR_MIN_BLOCKS, XFormJob::local, &job);
+
+	int nlevels = (int)level_start.size() - 1;
+	for(int i=0; i<nlevels; i++) {
+		job.offset = level_start[i];
+		parallel_for(level_start[i + 1] - level_start[i], PAR_MIN_SLOTS, XFormJob::world, &job);
+	}
+
+	dirty = false;
+}
+
+void XFormStore::local_range(int start_block, int end_block)
+{
+	for(int i=start_block; i<end_block; i++) {
+		XFormBlock *blk = blocks[i];
+		if(!blk->num_local_dirty) continue;
+
+		int count = num_slots - i * XFORM_BLOCK_SIZE;
+		if(count > XFORM_BLOCK_SIZE) count = XFORM_BLOCK_SIZE;
+
+		int j = 0;
+#ifdef USE_SSE
+		// 4 at a time, recomputing clean neighbours of dirty slots doesn't hurt
+		for(; j<=count - 4; j+=4) {
+			unsigned char fl = blk->flags[j] | blk->flags[j + 1] | blk->flags[j + 2] | blk->flags[j + 3];
+			if(fl & XFORM_LOCAL_DIRTY) {
+				calc_trs4(blk->pos + j, blk->rot + j, blk->scale + j, blk->local + j, blk->inv_local + j);
+				for(int k=0; k<4; k++) {
+					blk->flags[j + k] &= ~XFORM_LOCAL_DIRTY;
+				}
+			}
+		}
+#endif
+		for(; j<count; j++) {
+			if(blk->flags[j] & XFORM_LOCAL_DIRTY) {
+				calc_trs(blk->pos[j], blk->rot[j], blk->scale[j], blk->local + j, blk->inv_local + j);
+				blk->flags[j] &= ~XFORM_LOCAL_DIRTY;
+			}
+		}
+		blk->num_local_dirty = 0;
+	}
+}
+
+void XFormStore::world_range(int start, int end)
+{
+	for(int i=start; i<end; i++) {
+		int slot = order[i];
+		XFormBlock *blk = block(slot);
+		int idx = index(slot);
+
+		if(!(blk->flags[idx] & XFORM_WORLD_DIRTY)) {
+			continue;
+		}
+
+		int par = blk->parent[idx];
+		if(par >= 0) {
+			// the parent is on a previous level, and already up to date
+			XFormBlock *pblk = block(par);
+			int pidx = index(par);
+			blk->world[idx] = pblk->world[pidx] * blk->local[idx];
+			blk->inv_world[idx] = blk->inv_local[idx] * pblk->inv_world[pidx];
+		} else {
+			blk->world[idx] = blk->local[idx];
+			blk->inv_world[idx] = blk->inv_local[idx];
+		}
+		blk->flags[idx] &= ~XFORM_WORLD_DIRTY;
+	}
+}
+
+/* Both kernels build M = T * R * S and its inverse S^-1 * R^T * T^-1
+ * directly from the position, rotation and scaling, with the rotation
+ * matrix elements derived from the quaternion. Matrices are stored as
+ * m[column][row], the layout OpenGL expects.
+ */
+static void calc_trs(const Vec3 &pos, const Quat &rot, const Vec3 &scale, Mat4 *mat, Mat4 *inv)
+{
+	float x2 = rot.x + rot.x;
+	float y2 = rot.y + rot.y;
+	float z2 = rot.z + rot.z;
+	float xx = rot.x * x2, yy = rot.y * y2, zz = rot.z * z2;
+	float xy = rot.x * y2, xz = rot.x * z2, yz = rot.y * z2;
+	float wx = rot.w * x2, wy = rot.w * y2, wz = rot.w * z2;
+
+	float r[3][3] = {	// r[row][col]
+		{1.0f - (yy + zz), xy - wz, xz + wy},
+		{xy + wz, 1.0f - (xx + zz), yz - wx},
+		{xz - wy, yz + wx, 1.0f - (xx + yy)}
+	};
+	float inv_scale[3] = {1.0f / scale.x, 1.0f / scale.y, 1.0f / scale.z};
+
+	for(int i=0; i<3; i++) {
+		for(int j=0; j<3; j++) {
+			(*mat)[i][j] = r[j][i] * scale[i];
+			(*inv)[i][j] = r[i][j] * inv_scale[j];
+		}
+		(*mat)[i][3] = 0.0f;
+		(*inv)[i][3] = 0.0f;
+
+		(*mat)[3][i] = pos[i];
+		(*inv)[3][i] = -(r[0][i] * pos.x + r[1][i] * pos.y + r[2][i] * pos.z) * inv_scale[i];
+	}
+	(*mat)[3][3] = 1.0f;
+	(*inv)[3][3] = 1.0f;
+}
+
+#ifdef USE_SSE
+/* stores column col of 4 matrices, given the 4 rows of that column each
+ * holding the values of all 4 matrices
+ */
+static inline void store_column(Mat4 *mat, int col, __m128 r0, __m128 r1, __m128 r2, __m128 r3)
+{
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+	_mm_storeu_ps(mat[0][col], r0);
+	_mm_storeu_ps(mat[1][col], r1);
+	_mm_storeu_ps(mat[2][col], r2);
+	_mm_storeu_ps(mat[3][col], r3);
+}
+
+#define ADD(a, b)	_mm_add_ps(a, b)
+#define SUB(a, b)	_mm_sub_ps(a, b)
+#define MUL(a, b)	_mm_mul_ps(a, b)
+
+/* same as calc_trs for 4 transformations at once, with the quaternions
+ * transposed into x/y/z/w vectors.
+ */
+static void calc_trs4(const Vec3 *pos, const Quat *rot, const Vec3 *scale, Mat4 *mat, Mat4 *inv)
+{
+	static_assert(sizeof(Quat) == 4 * sizeof(float), "Quat expected to be 4 packed floats");
+
+	__m128 qx = _mm_loadu_ps(&rot[0].x);
+	__m128 qy = _mm_loadu_ps(&rot[1].x);
+	__m128 qz = _mm_loadu_ps(&rot[2].x);
+	__m128 qw = _mm_loadu_ps(&rot[3].x);
+	_MM_TRANSPOSE4_PS(qx, qy, qz, qw);
+
+	__m128 px = _mm_setr_ps(pos[0].x, pos[1].x, pos[2].x, pos[3].x);
+	__m128 py = _mm_setr_ps(pos[0].y, pos[1].y, pos[2].y, pos[3].y);
+	__m128 pz = _mm_setr_ps(pos[0].z, pos[1].z, pos[2].z, pos[3].z);
+	__m128 sx = _mm_setr_ps(scale[0].x, scale[1].x, scale[2].x, scale[3].x);
+	__m128 sy = _mm_setr_ps(scale[0].y, scale[1].y, scale[2].y, scale[3].y);
+	__m128 sz = _mm_setr_ps(scale[0].z, scale[1].z, scale[2].z, scale[3].z);
+
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 zero = _mm_setzero_ps();
+
+	__m128 x2 = ADD(qx, qx), y2 = ADD(qy, qy), z2 = ADD(qz, qz);
+	__m128 xx = MUL(qx, x2), yy = MUL(qy, y2), zz = MUL(qz, z2);
+	__m128 xy = MUL(qx, y2), xz = MUL(qx, z2), yz = MUL(qy, z2);
+	__m128 wx = MUL(qw, x2), wy = MUL(qw, y2), wz = MUL(qw, z2);
+
+	__m128 r00 = SUB(one, ADD(yy, zz)), r01 = SUB(xy, wz), r02 = ADD(xz, wy);
+	__m128 r10 = ADD(xy, wz), r11 = SUB(one, ADD(xx, zz)), r12 = SUB(yz, wx);
+	__m128 r20 = SUB(xz, wy), r21 = ADD(yz, wx), r22 = SUB(one, ADD(xx, yy));
+
+	store_column(mat, 0, MUL(r00, sx), MUL(r10, sx), MUL(r20, sx), zero);
+	store_column(mat, 1, MUL(r01, sy), MUL(r11, sy), MUL(r21, sy), zero);
+	store_column(mat, 2, MUL(r02, sz), MUL(r12, sz), MUL(r22, sz), zero);
+	store_column(mat, 3, px, py, pz, one);
+
+	__m128 isx = _mm_div_ps(one, sx);
+	__m128 isy = _mm_div_ps(one, sy);
+	__m128 isz = _mm_div_ps(one, sz);
+
+	store_column(inv, 0, MUL(r00, isx), MUL(r01, isy), MUL(r02, isz), zero);
+	store_column(inv, 1, MUL(r10, isx), MUL(r11, isy), MUL(r12, isz), zero);
+	store_column(inv, 2, MUL(r20, isx), MUL(r21, isy), MUL(r22, isz), zero);
+
+	__m128 tx = MUL(ADD(ADD(MUL(r00, px), MUL(r10, py)), MUL(r20, pz)), isx);
+	__m128 ty = MUL(ADD(ADD(MUL(r01, px), MUL(r11, py)), MUL(r21, pz)), isy);
+	__m128 tz = MUL(ADD(ADD(MUL(r02, px), MUL(r12, py)), MUL(r22, pz)), isz);
+	store_column(inv, 3, SUB(zero, tx), SUB(zero, ty), SUB(zero, tz), one);
+}
+#endif	// USE_SSE
+
+}	// namespace vrtk
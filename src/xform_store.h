@@ -0,0 +1,152 @@
+/*
+vrtk - 3D widget toolkit for VR user interfaces
+Copyright (C) 2017 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef XFORM_STORE_H_
+#define XFORM_STORE_H_
+
+#include <vector>
+#include <gmath/gmath.h>
+
+namespace vrtk {
+
+// slot flags
+enum {
+	XFORM_USED			= 1,
+	XFORM_LOCAL_DIRTY	= 2,	// local and inverse local matrices out of date
+	XFORM_WORLD_DIRTY	= 4		// world and inverse world matrices out of date
+};
+
+#define XFORM_BLOCK_SIZE	256
+
+/* Fixed-size block of transformation slots, with each attribute stored
+ * contiguously. Blocks are never moved or freed, so references to slot data
+ * stay valid for the lifetime of the slot.
+ */
+struct XFormBlock {
+	Vec3 pos[XFORM_BLOCK_SIZE];
+	Quat rot[XFORM_BLOCK_SIZE];
+	Vec3 scale[XFORM_BLOCK_SIZE];
+
+	Mat4 local[XFORM_BLOCK_SIZE];
+	Mat4 inv_local[XFORM_BLOCK_SIZE];
+	Mat4 world[XFORM_BLOCK_SIZE];
+	Mat4 inv_world[XFORM_BLOCK_SIZE];
+
+	int parent[XFORM_BLOCK_SIZE];	// parent slot or -1
+	unsigned char flags[XFORM_BLOCK_SIZE];
+	int num_local_dirty;
+};
+
+class XFormStore {
+private:
+	std::vector<XFormBlock*> blocks;
+	std::vector<int> free_slots;
+	int num_slots;
+
+	// used slots sorted by hierarchy depth, and the start of each level in it
+	std::vector<int> order;
+	std::vector<int> level_start;
+	bool order_valid;
+
+	bool dirty;		// any slot flagged dirty since the last update
+
+	void build_order();
+	void calc_local(int slot);
+
+	// batch kernels, called on ranges of blocks/order entries by XFormJob
+	void local_range(int start_block, int end_block);
+	void world_range(int start, int end);
+
+	friend struct XFormJob;
+
+public:
+	XFormStore();
+	~XFormStore();
+
+	int alloc();
+	void free(int slot);
+
+	inline XFormBlock *block(int slot) const;
+	inline int index(int slot) const;
+
+	// setters don't flag anything, see invalidate_local/invalidate_world
+	void set_pos(int slot, const Vec3 &pos);
+	void set_rot(int slot, const Quat &rot);
+	void set_scale(int slot, const Vec3 &scale);
+	void set_parent(int slot, int parent);
+
+	inline const Vec3 &get_pos(int slot) const;
+	inline const Quat &get_rot(int slot) const;
+	inline const Vec3 &get_scale(int slot) const;
+	inline int get_parent(int slot) const;
+
+	void invalidate_local(int slot);
+	/* flags the world matrices of the slot as out of date. Returns false if
+	 * they already were, in which case the subtree is already flagged too.
+	 */
+	bool invalidate_world(int slot);
+
+	// lazily computed, parents first if necessary
+	const Mat4 &get_local(int slot);
+	const Mat4 &get_world(int slot);
+	const Mat4 &get_inv_world(int slot);
+
+	/* batch update of all dirty slots: local matrices with the SIMD kernel,
+	 * then world matrices in hierarchy order. Large passes are split over the
+	 * worker threads.
+	 */
+	void update();
+
+	bool is_dirty() const;	// anything changed since the last update
+};
+
+/* the scene-wide transformation store used by all widgets */
+XFormStore *get_xform_store();
+
+inline XFormBlock *XFormStore::block(int slot) const
+{
+	return blocks[slot / XFORM_BLOCK_SIZE];
+}
+
+inline int XFormStore::index(int slot) const
+{
+	return slot % XFORM_BLOCK_SIZE;
+}
+
+inline const Vec3 &XFormStore::get_pos(int slot) const
+{
+	return block(slot)->pos[index(slot)];
+}
+
+inline const Quat &XFormStore::get_rot(int slot) const
+{
+	return block(slot)->rot[index(slot)];
+}
+
+inline const Vec3 &XFormStore::get_scale(int slot) const
+{
+	return block(slot)->scale[index(slot)];
+}
+
+inline int XFormStore::get_parent(int slot) const
+{
+	return block(slot)->parent[index(slot)];
+}
+
+}	// namespace vrtk
+
+#endif	// XFORM_STORE_H_